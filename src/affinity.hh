@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2023 Bryance Oyang
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif /* __linux__ */
+
+static inline void bad_cpu_list(const char *list)
+{
+	printf("bad cpu list \"%s\"\n", list);
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * cpu list like "0-3,8,10-11" in the order given, exits on malformed lists,
+ * empty for NULL or ""
+ */
+static inline std::vector<int> parse_cpu_list(const char *list)
+{
+	std::vector<int> cpus;
+
+	if (list == NULL) {
+		return cpus;
+	}
+
+	const char *s = list;
+	while (*s != '\0') {
+		char *end;
+		long lo = strtol(s, &end, 10);
+		long hi = lo;
+
+		if (end == s || lo < 0) {
+			bad_cpu_list(list);
+		}
+		s = end;
+		if (*s == '-') {
+			s++;
+			hi = strtol(s, &end, 10);
+			if (end == s || hi < lo) {
+				bad_cpu_list(list);
+			}
+			s = end;
+		}
+		for (long cpu = lo; cpu <= hi; cpu++) {
+			cpus.push_back((int)cpu);
+		}
+
+		if (*s == ',') {
+			s++;
+		} else if (*s != '\0') {
+			bad_cpu_list(list);
+		}
+	}
+	return cpus;
+}
+
+#ifdef __linux__
+typedef cpu_set_t cpu_mask;
+#else
+typedef int cpu_mask;
+#endif /* __linux__ */
+
+// calling thread's current cpus into mask
+static inline void get_affinity(cpu_mask *mask)
+{
+#ifdef __linux__
+	CPU_ZERO(mask);
+	pthread_getaffinity_np(pthread_self(), sizeof(*mask), mask);
+#else
+	*mask = 0;
+#endif /* __linux__ */
+}
+
+static inline void set_affinity(const cpu_mask *mask)
+{
+#ifdef __linux__
+	if (pthread_setaffinity_np(pthread_self(), sizeof(*mask), mask) != 0) {
+		printf("warning: could not set thread affinity\n");
+	}
+#else
+	(void)mask;
+#endif /* __linux__ */
+}
+
+/*
+ * confine the calling thread to cpus, threads it creates afterwards inherit
+ * this, no-op if cpus is empty
+ */
+static inline void confine_to_cpus(const std::vector<int> &cpus)
+{
+	if (cpus.empty()) {
+		return;
+	}
+
+#ifdef __linux__
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	for (int cpu : cpus) {
+		if (cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &mask);
+		}
+	}
+	set_affinity(&mask);
+#else
+	printf("warning: thread affinity is only supported on linux\n");
+#endif /* __linux__ */
+}
+
+// nice value of the calling thread only, no-op off linux
+static inline void lower_priority(int nice)
+{
+#ifdef __linux__
+	if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice) != 0) {
+		printf("warning: could not lower thread priority\n");
+	}
+#else
+	(void)nice;
+#endif /* __linux__ */
+}
+
+#endif /* AFFINITY_H */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2023 Bryance Oyang
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/mman.h>
+
+#include "config.hh"
+
+// alignment of every allocation and of padded rows
+#define ARENA_ALIGN 64
+#define ARENA_REGION_ALIGN (2UL << 20)
+
+/*
+ * Bump allocator over one 2 MiB aligned anonymous mapping, advised to be
+ * backed by transparent huge pages unless NUMA_POLICY is NUMA_FIRST_TOUCH (or
+ * mapped from the hugetlbfs pool with ARENA_HUGETLB). Allocations are ARENA_ALIGN aligned and only released all
+ * together when the arena is destroyed.
+ *
+ * Before reserve(), alloc() only counts the bytes it would hand out and
+ * returns NULL, so a counting pass over the same allocations sizes the
+ * region exactly.
+ */
+class Arena {
+public:
+	char *base = nullptr;
+	size_t capacity = 0;
+	size_t used = 0;
+	// mapping including alignment slack
+	void *map = nullptr;
+	size_t map_bytes = 0;
+
+	Arena() = default;
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+	~Arena() { release(); }
+
+	static size_t round_up(size_t bytes, size_t align)
+	{
+		return (bytes + align - 1) / align * align;
+	}
+
+	// elements per row of n so rows stay ARENA_ALIGN aligned
+	template<typename T> static int pad_row(int n)
+	{
+		return round_up(n * sizeof(T), ARENA_ALIGN) / sizeof(T);
+	}
+
+	void reserve(size_t bytes)
+	{
+		release();
+		capacity = round_up(bytes, ARENA_REGION_ALIGN);
+		used = 0;
+		if (capacity == 0) {
+			return;
+		}
+
+#if ARENA_HUGETLB
+		map_bytes = capacity;
+		map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (map != MAP_FAILED) {
+			base = (char *)map;
+			return;
+		}
+		static bool warned = false;
+		if (!warned) {
+			warned = true;
+			printf("warning: no hugetlbfs pages, using transparent huge pages\n");
+		}
+#endif /* ARENA_HUGETLB */
+
+		// over map and trim to a 2 MiB aligned start
+		map_bytes = capacity + ARENA_REGION_ALIGN;
+		map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (map == MAP_FAILED) {
+			printf("could not map %zu bytes for grid arena\n", map_bytes);
+			exit(EXIT_FAILURE);
+		}
+		base = (char *)round_up((uintptr_t)map, ARENA_REGION_ALIGN);
+
+		// a huge page is placed whole by its first toucher, which would undo
+		// placing each tile on its own node
+#if NUMA_POLICY == NUMA_FIRST_TOUCH && defined(MADV_NOHUGEPAGE)
+		madvise(base, capacity, MADV_NOHUGEPAGE);
+#elif defined(MADV_HUGEPAGE)
+		madvise(base, capacity, MADV_HUGEPAGE);
+#endif
+	}
+
+	void *alloc(size_t bytes)
+	{
+		size_t offset = used;
+
+		used += round_up(bytes, ARENA_ALIGN);
+		if (base == nullptr) {
+			// counting pass
+			return nullptr;
+		}
+		if (used > capacity) {
+			printf("grid arena overflow\n");
+			exit(EXIT_FAILURE);
+		}
+		return base + offset;
+	}
+
+	void release()
+	{
+		if (map != nullptr) {
+			munmap(map, map_bytes);
+		}
+		map = nullptr;
+		map_bytes = 0;
+		base = nullptr;
+		capacity = 0;
+		used = 0;
+	}
+};
+
+#endif /* ARENA_H */
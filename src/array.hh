@@ -4,6 +4,8 @@
 #include <cstring>
 #include <utility>
 
+#include "arena.hh"
+
 #define MAX_ARRAY_RANK 5
 
 /** contiguous in memory for cache efficiency accessed with A(i,j,k) */
@@ -13,17 +15,26 @@ public:
 	int n[MAX_ARRAY_RANK];
 	int len;
 	T *data = nullptr;
+	// data is carved from an Arena which releases it
+	bool in_arena = false;
 
 	void alloc()
 	{
 		data = new T[len];
+		in_arena = false;
+	}
+	void alloc(Arena &arena)
+	{
+		data = (T *)arena.alloc(bytes());
+		in_arena = true;
 	}
 	void free()
 	{
-		if (data) {
+		if (data && !in_arena) {
 			delete[] data;
-			data = nullptr;
 		}
+		data = nullptr;
+		in_arena = false;
 	}
 	size_t bytes() const
 	{
@@ -83,6 +94,21 @@ public:
 	n{n0, n1, n2, n3, n4},
 	len{n0*n1*n2*n3*n4} { alloc(); }
 
+	Array(Arena &arena, int n0)
+	: rank{1},
+	n{n0, 1, 1, 1, 1},
+	len{n0} { alloc(arena); }
+
+	Array(Arena &arena, int n0, int n1)
+	: rank{2},
+	n{n0, n1, 1, 1, 1},
+	len{n0*n1} { alloc(arena); }
+
+	Array(Arena &arena, int n0, int n1, int n2)
+	: rank{3},
+	n{n0, n1, n2, 1, 1},
+	len{n0*n1*n2} { alloc(arena); }
+
 	~Array() { free(); }
 
 	friend void swap(Array &first, Array &second)
@@ -92,6 +118,7 @@ public:
 		swap(first.rank, second.rank);
 		swap(first.n, second.n);
 		swap(first.data, second.data);
+		swap(first.in_arena, second.in_arena);
 	}
 
 	Array(const Array &other)
@@ -123,27 +150,27 @@ public:
 
 	T &operator()(int i0)
 	{ return data[i0]; }
-	T operator()(int i0) const
+	const T &operator()(int i0) const
 	{ return data[i0]; }
 
 	T &operator()(int i0, int i1)
 	{ return data[i0*n[1] + i1]; }
-	T operator()(int i0, int i1) const
+	const T &operator()(int i0, int i1) const
 	{ return data[i0*n[1] + i1]; }
 
 	T &operator()(int i0, int i1, int i2)
 	{ return data[(i0*n[1] + i1)*n[2] + i2]; }
-	T operator()(int i0, int i1, int i2) const
+	const T &operator()(int i0, int i1, int i2) const
 	{ return data[(i0*n[1] + i1)*n[2] + i2]; }
 
 	T &operator()(int i0, int i1, int i2, int i3)
 	{ return data[((i0*n[1] + i1)*n[2] + i2)*n[3] + i3]; }
-	T operator()(int i0, int i1, int i2, int i3) const
+	const T &operator()(int i0, int i1, int i2, int i3) const
 	{ return data[((i0*n[1] + i1)*n[2] + i2)*n[3] + i3]; }
 
 	T &operator()(int i0, int i1, int i2, int i3, int i4)
 	{ return data[(((i0*n[1] + i1)*n[2] + i2)*n[3] + i3)*n[4] + i4]; }
-	T operator()(int i0, int i1, int i2, int i3, int i4) const
+	const T &operator()(int i0, int i1, int i2, int i3, int i4) const
 	{ return data[(((i0*n[1] + i1)*n[2] + i2)*n[3] + i3)*n[4] + i4]; }
 };
 
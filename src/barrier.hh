@@ -1,10 +1,23 @@
 #ifndef BARRIER_H
 #define BARRIER_H
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
+#include <vector>
 
-class ThreadBarrier {
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif /* __linux__ */
+
+#include "config.hh"
+
+class MutexBarrier {
 public:
 	std::mutex mutex;
 	std::condition_variable cond;
@@ -12,7 +25,7 @@ public:
 	int nwaiting;
 	const int nthread;
 
-	ThreadBarrier(int nthread) : gate_id{0}, nwaiting{0}, nthread{nthread} {};
+	MutexBarrier(int nthread) : gate_id{0}, nwaiting{0}, nthread{nthread} {};
 
 	void wait() {
 		std::unique_lock<std::mutex> lock{mutex};
@@ -31,4 +44,182 @@ public:
 	}
 };
 
+static inline void barrier_pause()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/*
+ * Gate shared by the spinning barriers: waiters spin with exponential backoff
+ * while gate_id is unchanged and sleep on it after BARRIER_SPIN_BUDGET
+ * pauses, nsleeping lets the opener skip the wake syscall when nobody sleeps.
+ * The gate_id generation replaces a per-thread sense flag.
+ */
+class alignas(64) BarrierGate {
+public:
+	alignas(64) std::atomic<int> gate_id{0};
+	alignas(64) std::atomic<int> nsleeping{0};
+
+	int current() {
+		return gate_id.load(std::memory_order_acquire);
+	}
+
+	void wait(int current_gate) {
+		int npause = 1;
+
+		for (int spin = 0; spin < BARRIER_SPIN_BUDGET; spin += npause) {
+			if (gate_id.load(std::memory_order_acquire) != current_gate) {
+				return;
+			}
+			for (int k = 0; k < npause; k++) {
+				barrier_pause();
+			}
+			if (npause < 64) {
+				npause *= 2;
+			} else {
+				// oversubscribed cores
+				std::this_thread::yield();
+			}
+		}
+
+		nsleeping.fetch_add(1);
+		while (gate_id.load() == current_gate) {
+#ifdef __linux__
+			syscall(SYS_futex, (int *)&gate_id, FUTEX_WAIT_PRIVATE, current_gate, NULL, NULL, 0);
+#else
+			std::this_thread::yield();
+#endif /* __linux__ */
+		}
+		nsleeping.fetch_sub(1);
+	}
+
+	void open() {
+		gate_id.fetch_add(1);
+#ifdef __linux__
+		if (nsleeping.load() > 0) {
+			syscall(SYS_futex, (int *)&gate_id, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+		}
+#endif /* __linux__ */
+	}
+};
+
+// one padded arrival counter
+class SpinBarrier {
+public:
+	alignas(64) std::atomic<int> nwaiting{0};
+	BarrierGate gate;
+	const int nthread;
+
+	SpinBarrier(int nthread) : nthread{nthread} {};
+
+	void wait() {
+		int current_gate = gate.current();
+
+		if (nwaiting.fetch_add(1, std::memory_order_acq_rel) + 1 == nthread) {
+			nwaiting.store(0, std::memory_order_relaxed);
+			gate.open();
+		} else {
+			gate.wait(current_gate);
+		}
+	}
+};
+
+/*
+ * Arrivals combine up a tree of padded counters with BARRIER_TREE_FANIN
+ * children each so no counter is shared by more than that many threads, the
+ * last one at the root opens the gate. Each arrival takes the next ticket of
+ * the round as its leaf, so callers need no thread ids, and the opener resets
+ * the tickets before any thread can arrive for the next round.
+ */
+class TreeBarrier {
+public:
+	class alignas(64) Node {
+	public:
+		std::atomic<int> nwaiting{0};
+		int nchild = 0;
+	};
+
+	std::vector<std::vector<Node>> levels;
+	alignas(64) std::atomic<int> ticket{0};
+	BarrierGate gate;
+	const int nthread;
+
+	TreeBarrier(int nthread) : nthread{nthread} {
+		int nchild = nthread;
+
+		do {
+			int nnode = (nchild + BARRIER_TREE_FANIN - 1) / BARRIER_TREE_FANIN;
+
+			levels.emplace_back(nnode);
+			for (int k = 0; k < nnode; k++) {
+				levels.back()[k].nchild = std::min(BARRIER_TREE_FANIN, nchild - k*BARRIER_TREE_FANIN);
+			}
+			nchild = nnode;
+		} while (nchild > 1);
+	};
+
+	void wait() {
+		int current_gate = gate.current();
+		int k = ticket.fetch_add(1, std::memory_order_relaxed);
+
+		for (auto &level : levels) {
+			k /= BARRIER_TREE_FANIN;
+			Node &node = level[k];
+
+			if (node.nwaiting.fetch_add(1, std::memory_order_acq_rel) + 1 < node.nchild) {
+				gate.wait(current_gate);
+				return;
+			}
+			node.nwaiting.store(0, std::memory_order_relaxed);
+		}
+
+		ticket.store(0, std::memory_order_relaxed);
+		gate.open();
+	}
+};
+
+/*
+ * Point to point sync between neighboring tiles: each tile opens its own gate
+ * once per phase it finishes, so its gate_id counts its finished phases and a
+ * tile waits only on the gates of the tiles whose data it reads. The any gate
+ * is opened after every publish for waiting on whichever tile goes next.
+ */
+class EpochSync {
+public:
+	std::vector<BarrierGate> gates;
+	BarrierGate any;
+
+	EpochSync(int ntile) : gates(ntile) {};
+
+	void publish(int tid) {
+		gates[tid].open();
+		any.open();
+	}
+
+	// whether tile tid has finished epoch phases, wrap safe
+	bool reached(int tid, int epoch) {
+		return (int)((unsigned)gates[tid].current() - (unsigned)epoch) >= 0;
+	}
+
+	// until tile tid has finished epoch phases
+	void wait(int tid, int epoch) {
+		BarrierGate &gate = gates[tid];
+
+		for (int current = gate.current(); (int)((unsigned)current - (unsigned)epoch) < 0;
+			current = gate.current()) {
+			gate.wait(current);
+		}
+	}
+};
+
+#if BARRIER_TYPE == BARRIER_TREE
+typedef TreeBarrier ThreadBarrier;
+#elif BARRIER_TYPE == BARRIER_SPIN
+typedef SpinBarrier ThreadBarrier;
+#else
+typedef MutexBarrier ThreadBarrier;
+#endif
+
 #endif /* BARRIER_H */
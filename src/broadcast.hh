@@ -9,69 +9,170 @@
 #ifndef BROADCAST_H
 #define BROADCAST_H
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <thread>
 #include <mutex>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <cmath>
+#include <vector>
 
+#include "affinity.hh"
 #include "ws_ctube.hh"
 #include "grid.hh"
 
+/*
+ * Density to RGB in one pass through a table indexed by the binary exponent
+ * and leading COLORMAP_MANTISSA_BITS mantissa bits of the density, so a cell
+ * costs a few integer ops and a lookup instead of a log10. Entries are evenly
+ * spaced in log density and colored by BROADCAST_COLORMAP over log10 density
+ * [BROADCAST_LOG10_MIN, BROADCAST_LOG10_MAX], clipped outside.
+ */
 class GridConverter {
 public:
-	Array<number> preimage;
-	Array<uint8_t> image;
+	static const int COLORMAP_MANTISSA_BITS = 6;
+
+	// lowest binary exponent in the table
+	int exp_min;
+	int nentry;
+	// 3 bytes per entry
+	std::vector<uint8_t> table;
 
 	GridConverter() {
-		preimage = Array<number>{NU, NV};
-		image = Array<uint8_t>{NU, NV, 3};
-	}
+		exp_min = (int)floor(BROADCAST_LOG10_MIN * log2(10.0)) - 1;
+		int exp_max = (int)floor(BROADCAST_LOG10_MAX * log2(10.0)) + 1;
 
-	number clip(number x)
-	{
-		return fmax(BROADCAST_PREIMAGE_MIN, fmin(BROADCAST_PREIMAGE_MAX, x));
+		nentry = (exp_max - exp_min + 1) << COLORMAP_MANTISSA_BITS;
+		table.resize(3 * nentry);
+		for (int k = 0; k < nentry; k++) {
+			int e = exp_min + (k >> COLORMAP_MANTISSA_BITS);
+			int m = k & ((1 << COLORMAP_MANTISSA_BITS) - 1);
+
+			// middle of the entry's range
+			number x = ldexp(1 + (m + 0.5) / (1 << COLORMAP_MANTISSA_BITS), e);
+			number t = (log10(x) - BROADCAST_LOG10_MIN) / (BROADCAST_LOG10_MAX - BROADCAST_LOG10_MIN);
+			color(fmax(0, fmin(1, t)), &table[3*k]);
+		}
 	}
 
-	void make_image(const Grid &g)
+	// anchors evenly spaced over [0, 1], linearly interpolated
+	static void color(number t, uint8_t *rgb)
 	{
-		for (int i = 0; i < preimage.n[0]; i++) {
-			for (int j = 0; j < preimage.n[1]; j++) {
-				preimage(i, j) = clip(log10(g.cons(0, i+NGHOST, j+NGHOST)));
-			}
+#if BROADCAST_COLORMAP == COLORMAP_VIRIDIS
+		static const uint8_t anchors[][3] = {
+			{68, 1, 84}, {71, 44, 122}, {59, 82, 139}, {44, 113, 142},
+			{33, 145, 140}, {39, 173, 129}, {94, 201, 98}, {173, 220, 48},
+			{253, 231, 37}
+		};
+#elif BROADCAST_COLORMAP == COLORMAP_MAGMA
+		static const uint8_t anchors[][3] = {
+			{0, 0, 4}, {24, 15, 61}, {68, 15, 118}, {114, 31, 129},
+			{158, 47, 127}, {205, 64, 113}, {241, 96, 93}, {253, 150, 104},
+			{252, 253, 191}
+		};
+#else
+		static const uint8_t anchors[][3] = {
+			{0, 0, 0}, {255, 255, 255}
+		};
+#endif
+		const int nanchor = sizeof(anchors) / sizeof(anchors[0]);
+		number s = t * (nanchor - 1);
+		int a = std::min((int)s, nanchor - 2);
+		number w = s - a;
+
+		for (int c = 0; c < 3; c++) {
+			rgb[c] = (uint8_t)lround((1 - w) * anchors[a][c] + w * anchors[a+1][c]);
 		}
-		image_from_preimage();
 	}
 
-	void image_from_preimage()
+	// n densities to 3n bytes of RGB
+	void convert_row(const number *rho, uint8_t *rgb, int n) const
 	{
-		for (int i = 0; i < preimage.n[0]; i++) {
-			for (int j = 0; j < preimage.n[1]; j++) {
-				uint8_t value = (uint8_t)(255.001 * (preimage(i, j) - BROADCAST_PREIMAGE_MIN) / (BROADCAST_PREIMAGE_MAX - BROADCAST_PREIMAGE_MIN));
-				for (int k = 0; k < 3; k++) {
-					image(i, j, k) = value;
-				}
-			}
+		const int64_t key_min = (int64_t)(exp_min + 1023) << COLORMAP_MANTISSA_BITS;
+
+		for (int k = 0; k < n; k++) {
+			uint64_t bits;
+			memcpy(&bits, &rho[k], sizeof(bits));
+
+			// sign, biased exponent and leading mantissa bits
+			int64_t key = (int64_t)(bits >> (52 - COLORMAP_MANTISSA_BITS)) - key_min;
+			key = std::max((int64_t)0, std::min((int64_t)nentry - 1, key));
+
+			rgb[3*k + 0] = table[3*key + 0];
+			rgb[3*k + 1] = table[3*key + 1];
+			rgb[3*k + 2] = table[3*key + 2];
 		}
 	}
 };
 
+/*
+ * Frames of the nonghost density are colored by the tiles in parallel and
+ * sent by a low priority thread so the solver never waits on it. Frames go
+ * through a triple buffer: the tiles fill the write buffer, the last one to
+ * finish swaps it with the ready buffer and marks it fresh, and the sender
+ * swaps a fresh ready buffer with the one it reads, so a slow sender only
+ * drops frames.
+ */
 class Broadcaster {
 public:
 	ws_ctube *ctube = NULL;
 	Grid &g;
 	GridConverter converter;
 
-	Broadcaster(Grid &g, int port, int max_nclient, int timeout_ms, number max_broadcast_fps)
+	Array<uint8_t> frames[3];
+	// ready buffer and FRESH if not yet sent
+	std::atomic<int> ready{1};
+	static const int FRESH = 4;
+	// only changed by the last tile of a frame, and frames are at least
+	// a step apart
+	int write = 0;
+	// sender thread's
+	int read = 2;
+	// tiles done with the write buffer
+	alignas(64) std::atomic<int> nwritten{0};
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool stop = false;
+	std::unique_ptr<std::thread> thread;
+
+	// server and sender threads are confined to cpus unless empty
+	Broadcaster(Grid &g, int port, int max_nclient, int timeout_ms, number max_broadcast_fps,
+		const std::vector<int> &cpus = {})
 	: g{g} {
-		start_ctube(port, max_nclient, timeout_ms, max_broadcast_fps);
+		for (Array<uint8_t> &frame : frames) {
+			frame = Array<uint8_t>{NU, NV, 3};
+		}
+		start_ctube(port, max_nclient, timeout_ms, max_broadcast_fps, cpus);
+		thread = std::make_unique<std::thread>(&Broadcaster::sender_main, this, cpus);
+	}
+	~Broadcaster() {
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			stop = true;
+		}
+		cond.notify_one();
+		thread->join();
 	}
 
-	bool start_ctube(int port, int max_nclient, int timeout_ms, number max_broadcast_fps)
+	bool start_ctube(int port, int max_nclient, int timeout_ms, number max_broadcast_fps,
+		const std::vector<int> &cpus = {})
 	{
 		stop_ctube();
+
+		// ws_ctube threads inherit the affinity of the thread opening it
+		cpu_mask mask;
+		get_affinity(&mask);
+		confine_to_cpus(cpus);
 		ctube = ws_ctube_open(port, max_nclient, timeout_ms, max_broadcast_fps);
+		if (!cpus.empty()) {
+			set_affinity(&mask);
+		}
+
 		return ctube != NULL;
 	}
 	void stop_ctube()
@@ -82,10 +183,48 @@ public:
 		}
 	}
 
-	void broadcast() {
-		converter.make_image(g);
-		ws_ctube_broadcast(ctube, converter.image.data,
-			converter.image.bytes());
+	// tile local grid's nonghost density colored into the frame being written
+	void snapshot(const Grid &tile)
+	{
+		Array<uint8_t> &frame = frames[write];
+
+		for (int i = tile.il; i < tile.iu; i++) {
+			converter.convert_row(&tile.cons(0,i,tile.jl),
+				&frame(i-NGHOST, tile.jl-NGHOST, 0), tile.ju - tile.jl);
+		}
+
+		if (nwritten.fetch_add(1, std::memory_order_acq_rel) + 1 == tile.ntile) {
+			nwritten.store(0, std::memory_order_relaxed);
+			write = ready.exchange(write | FRESH, std::memory_order_acq_rel) & ~FRESH;
+
+			// empty critical section so the sender is either before
+			// its check or waiting
+			{
+				std::lock_guard<std::mutex> lock{mutex};
+			}
+			cond.notify_one();
+		}
+	}
+
+	void sender_main(std::vector<int> cpus)
+	{
+		confine_to_cpus(cpus);
+		lower_priority(BROADCAST_NICE);
+
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock{mutex};
+				while (!stop && !(ready.load(std::memory_order_acquire) & FRESH)) {
+					cond.wait(lock);
+				}
+				if (stop) {
+					return;
+				}
+			}
+
+			read = ready.exchange(read, std::memory_order_acq_rel) & ~FRESH;
+			ws_ctube_broadcast(ctube, frames[read].data, frames[read].bytes());
+		}
 	}
 };
 
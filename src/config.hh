@@ -1,6 +1,7 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+// default number of threads, overridden at runtime by -n or FLUID_NTHREAD
 #define NTHREAD 8
 
 #define NU 320
@@ -10,6 +11,68 @@
 
 #define NGHOST 4
 
+// the grid is cut into TILES_PER_THREAD tiles per thread, which threads run
+// phase by phase as their neighbors are ready and steal from each other
+#define TILES_PER_THREAD 2
+
+// every REBALANCE_STEPS steps, move the cuts between rows and columns of
+// tiles toward equal measured compute time, if the slowest is more than
+// REBALANCE_TOLERANCE over the mean, 0 to keep the tiles fixed. results
+// do not depend on where the cuts fall as long as the build does not
+// contract into fma (see Makefile), so the timing only moves the work
+#define REBALANCE_STEPS 20
+#define REBALANCE_TOLERANCE 0.1
+
+// TILE_NU x TILE_NV tiles of the grid (product must be the number of tiles),
+// 0 to pick the tiling with the least halo perimeter
+#define TILE_NU 0
+#define TILE_NV 0
+
+#define NUMA_FIRST_TOUCH 0
+#define NUMA_INTERLEAVE 1
+// NUMA_FIRST_TOUCH puts the pages of each tile on the node of the thread that
+// owns it, NUMA_INTERLEAVE spreads the shared grid arrays over all nodes.
+// first touch keeps the arena on 4 KiB pages since a 2 MiB page spans rows
+// of several tiles and would land whole on one node, trading more tlb misses
+// for local memory; interleave asks for transparent huge pages
+#define NUMA_POLICY NUMA_FIRST_TOUCH
+
+// map the grid arena from preallocated hugetlbfs pages instead of
+// transparent huge pages, which also places whole 2 MiB pages under
+// NUMA_FIRST_TOUCH
+#define ARENA_HUGETLB 0
+
+#define BARRIER_MUTEX 0
+#define BARRIER_SPIN 1
+#define BARRIER_TREE 2
+// ThreadBarrier: BARRIER_MUTEX sleeps on a condition variable, BARRIER_SPIN
+// spins on one padded counter before sleeping on a futex, BARRIER_TREE
+// combines arrivals in a tree of counters for high thread counts
+#define BARRIER_TYPE BARRIER_SPIN
+// pause instructions to spin before sleeping
+#define BARRIER_SPIN_BUDGET 20000
+#define BARRIER_TREE_FANIN 4
+
+// sweep and update the cells and faces of a tile that need no neighbor data
+// while waiting for the neighbors, then finish its NGHOST wide edges
+#define OVERLAP_EDGES 1
+
+// reconstruct through riemann flux one row at a time in thread local scratch
+// instead of full grid passes
+#define FUSED_SWEEP 1
+// columns per transposed tile so the fused x sweep is also unit stride, 0 to
+// sweep x row by row instead
+#define TRANSPOSE_TILE 8
+
+// branch free HLLC over native simd width of faces (needs <experimental/simd>)
+#define SIMD_HLLC 1
+// branch free PPM over native simd width of cells
+#define SIMD_PPM 1
+
+// stable cfl_num of one forward Euler step, integrators recommend this times
+// their ssp coefficient
+#define CFL_EULER 0.3
+
 // should be 0 unless large discontinuities
 #define PPM_ALWAYS_LIM 0
 // maybe good for nan cleaning
@@ -18,7 +81,14 @@
 // probably should be 0?
 #define WEIRD_PPM 0
 
-#define BROADCAST_PREIMAGE_MIN (-1)
-#define BROADCAST_PREIMAGE_MAX 1
+#define COLORMAP_GREY 0
+#define COLORMAP_VIRIDIS 1
+#define COLORMAP_MAGMA 2
+// colormap of log10 density over [BROADCAST_LOG10_MIN, BROADCAST_LOG10_MAX]
+#define BROADCAST_COLORMAP COLORMAP_VIRIDIS
+#define BROADCAST_LOG10_MIN (-1)
+#define BROADCAST_LOG10_MAX 1
+// nice value of the thread sending frames
+#define BROADCAST_NICE 10
 
 #endif /* CONFIG_H */
@@ -8,6 +8,7 @@
 
 #include "grid.hh"
 #include "riemann.hh"
+#include "numa.hh"
 
 #include <cmath>
 #include <cstdio>
@@ -24,17 +25,16 @@ void Grid::InitGrid()
 		printf("Bad reconstruct_order\n");
 		exit(EXIT_FAILURE);
 	}
+	if (riemann_solver < 0 || riemann_solver >= NSOLVER) {
+		printf("Bad riemann_solver\n");
+		exit(EXIT_FAILURE);
+	}
 
 	AllocGrid();
 	InitUVCoord();
 
-	InitCond();
-
-	ConsLim();
-	ConsToPrim();
-	Boundary(time);
-	ConsLim();
-	ConsToPrim();
+	// the threads first touch their home tiles before InitCond and
+	// ConsLim set the state
 }
 
 void Grid::AllocGrid()
@@ -50,35 +50,111 @@ void Grid::AllocGrid()
 	time = 0;
 	dt = 0;
 
+	// the global grid owns every nonghost cell
+	il = NGHOST;
+	iu = nu - NGHOST;
+	iuf = iu + 1;
+	ilr = il - 1;
+	iur = iu + 1;
+	jl = NGHOST;
+	ju = nv - NGHOST;
+	juf = ju + 1;
+	jlr = jl - 1;
+	jur = ju + 1;
+
+	// count, then carve every field from one arena
+	Arena counter;
+	AllocFields(counter);
+	arena.reserve(counter.used);
+	AllocFields(arena);
+
+	dt_tile = Array<number>{2, ntile};
+
+	if (NUMA_POLICY == NUMA_INTERLEAVE) {
+		for (Array<number> *a : {&cons, &prim, &cons_gen, &src, &Ju, &Jv,
+			&Lprim, &Lcons, &Rprim, &Rcons, &LJ, &RJ, &Lw, &Rw}) {
+			numa_interleave(a->data, a->bytes());
+		}
+	}
+}
+
+/*
+ * fields from an arena with rows padded to ARENA_ALIGN, so strides come from
+ * Array::n and not nu, nv
+ */
+void Grid::AllocFields(Arena &from)
+{
+	const int nvc = Arena::pad_row<number>(nv);
+	const int nvf = Arena::pad_row<number>(nv+1);
+
 	// coordinates
-	u_cc = Array<number>{nu};
-	v_cc = Array<number>{nv};
-	u_ufc = Array<number>{nu+1};
-	v_ufc = Array<number>{nv+1};
-	u_vfc = Array<number>{nu+1};
-	v_vfc = Array<number>{nv+1};
+	u_cc = Array<number>{from, nu};
+	v_cc = Array<number>{from, nv};
+	u_ufc = Array<number>{from, nu+1};
+	v_ufc = Array<number>{from, nv+1};
+	u_vfc = Array<number>{from, nu+1};
+	v_vfc = Array<number>{from, nv+1};
 
 	// hydro
-	cons = Array<number>{NQUANT, nu, nv};
-	prim = Array<number>{NQUANT, nu, nv};
-	cons_gen = Array<number>{NQUANT, nu, nv};
+	cons = Array<number>{from, NQUANT, nu, nvc};
+	prim = Array<number>{from, NQUANT, nu, nvc};
+	cons_gen = Array<number>{from, NQUANT, nu, nvc};
 
-	fluxdiv = Array<number>{NQUANT, nu, nv};
-	src = Array<number>{NQUANT, nu, nv};
+	src = Array<number>{from, NQUANT, nu, nvc};
 
 	// current
-	Ju = Array<number>{NQUANT, nu+1, nv+1};
-	Jv = Array<number>{NQUANT, nu+1, nv+1};
-
-	// reconstruction vars
-	Lprim = Array<number>{NQUANT, nu+1, nv+1};
-	Lcons = Array<number>{NQUANT, nu+1, nv+1};
-	Rprim = Array<number>{NQUANT, nu+1, nv+1};
-	Rcons = Array<number>{NQUANT, nu+1, nv+1};
-
-	// wavespeed
-	Lw = Array<number>{nu+1, nv+1};
-	Rw = Array<number>{nu+1, nv+1};
+	Ju = Array<number>{from, NQUANT, nu+1, nvf};
+	Jv = Array<number>{from, NQUANT, nu+1, nvf};
+
+	// fused sweep keeps these in tile local rows instead
+	if (!FUSED_SWEEP) {
+		// reconstruction vars
+		Lprim = Array<number>{from, NQUANT, nu+1, nvf};
+		Lcons = Array<number>{from, NQUANT, nu+1, nvf};
+		Rprim = Array<number>{from, NQUANT, nu+1, nvf};
+		Rcons = Array<number>{from, NQUANT, nu+1, nvf};
+		if (riemann_solver == SOLVER_HLLE) {
+			LJ = Array<number>{from, NQUANT, nu+1, nvf};
+			RJ = Array<number>{from, NQUANT, nu+1, nvf};
+		}
+
+		// wavespeed
+		Lw = Array<number>{from, nu+1, nvf};
+		Rw = Array<number>{from, nu+1, nvf};
+	}
+}
+
+/*
+ * zero this tile of the shared arrays, plus the ghosts and domain edge faces
+ * on its sides, so its pages are placed on the numa node of its home thread
+ * when first touched from the thread that mostly computes on them
+ */
+void Grid::FirstTouch()
+{
+	for (Array<number> *a : {&cons, &prim, &cons_gen, &src, &Ju, &Jv,
+		&Lprim, &Lcons, &Rprim, &Rcons, &LJ, &RJ, &Lw, &Rw}) {
+		if (a->len == 0) {
+			continue;
+		}
+
+		// quantities for (m,i,j) arrays, 1 for (i,j) arrays
+		const int nm = (a->rank == 3) ? a->n[0] : 1;
+		const int ni = (a->rank == 3) ? a->n[1] : a->n[0];
+		const int nj = (a->rank == 3) ? a->n[2] : a->n[1];
+		const int iil = (il == NGHOST) ? 0 : il;
+		const int iiu = (iu == nu-NGHOST) ? ni : iu;
+		const int jjl = (jl == NGHOST) ? 0 : jl;
+		const int jju = (ju == nv-NGHOST) ? nj : ju;
+
+		for (int m = 0; m < nm; m++) {
+			for (int i = iil; i < iiu; i++) {
+				number *row = &a->data[(m*ni + i)*nj];
+				for (int j = jjl; j < jju; j++) {
+					row[j] = 0;
+				}
+			}
+		}
+	}
 }
 
 void Grid::AttachReference(Grid &g)
@@ -91,6 +167,7 @@ void Grid::AttachReference(Grid &g)
 	vmax = g.vmax;
 	du = g.du;
 	dv = g.dv;
+	ntile = g.ntile;
 
 	u_cc.attach_reference(g.u_cc);
 	v_cc.attach_reference(g.v_cc);
@@ -101,7 +178,6 @@ void Grid::AttachReference(Grid &g)
 	cons.attach_reference(g.cons);
 	prim.attach_reference(g.prim);
 	cons_gen.attach_reference(g.cons_gen);
-	fluxdiv.attach_reference(g.fluxdiv);
 	src.attach_reference(g.src);
 	Ju.attach_reference(g.Ju);
 	Jv.attach_reference(g.Jv);
@@ -109,10 +185,14 @@ void Grid::AttachReference(Grid &g)
 	Lcons.attach_reference(g.Lcons);
 	Rprim.attach_reference(g.Rprim);
 	Rcons.attach_reference(g.Rcons);
+	LJ.attach_reference(g.LJ);
+	RJ.attach_reference(g.RJ);
 	Lw.attach_reference(g.Lw);
 	Rw.attach_reference(g.Rw);
+	dt_tile.attach_reference(g.dt_tile);
 
 	reconstruct_order = g.reconstruct_order;
+	riemann_solver = g.riemann_solver;
 	rho_floor = g.rho_floor;
 	press_floor = g.press_floor;
 	gamma = g.gamma;
@@ -129,7 +209,6 @@ void Grid::DetachReference()
 	cons.detach_reference();
 	prim.detach_reference();
 	cons_gen.detach_reference();
-	fluxdiv.detach_reference();
 	src.detach_reference();
 	Ju.detach_reference();
 	Jv.detach_reference();
@@ -137,8 +216,17 @@ void Grid::DetachReference()
 	Lcons.detach_reference();
 	Rprim.detach_reference();
 	Rcons.detach_reference();
+	LJ.detach_reference();
+	RJ.detach_reference();
 	Lw.detach_reference();
 	Rw.detach_reference();
+	dt_tile.detach_reference();
+}
+
+// swap cons and cons_gen by pointer, each grid referencing them must do this
+void Grid::RotateState()
+{
+	swap(cons, cons_gen);
 }
 
 void Grid::InitUVCoord()
@@ -17,6 +17,12 @@
 
 #define NQUANT ((int)(4+(int)(NSCALAR)))
 
+enum RiemannSolver {
+	SOLVER_HLLC,
+	SOLVER_HLLE,
+	NSOLVER
+};
+
 class Grid {
 public:
 	int nu;
@@ -28,8 +34,11 @@ public:
 	number du;
 	number dv;
 
+	// tile of a local grid, -1 for the global grid
 	int tid;
-	// for nonghost of thread division
+	// tiles sharing the global grid, chosen at runtime
+	int ntile = NTHREAD;
+	// for nonghost of tile
 	int il;
 	int iu;
 	int iuf; // for face loops
@@ -38,8 +47,12 @@ public:
 
 	int jl;
 	int ju;
+	int juf; // for face loops
+	int jlr; // for reconstruction
+	int jur; // for reconstruction
 
 	int reconstruct_order;
+	int riemann_solver;
 
 	number &time;
 	number &dt;
@@ -61,9 +74,10 @@ public:
 
 	Array<number> cons;
 	Array<number> prim;
+	// state at the start of the step, cons and cons_gen are rotated by
+	// RotateState before stage 0 instead of copied
 	Array<number> cons_gen;
 
-	Array<number> fluxdiv;
 	Array<number> src;
 
 	Array<number> Ju;
@@ -74,11 +88,36 @@ public:
 	Array<number> Lcons;
 	Array<number> Rprim;
 	Array<number> Rcons;
+	// physical flux of reconstructed states for SOLVER_HLLE
+	Array<number> LJ;
+	Array<number> RJ;
 
 	// wavespeed
 	Array<number> Lw;
 	Array<number> Rw;
 
+	// per-tile minimum cell crossing time, (dt_slot, tid) alternating
+	// slots every step so a tile may reset its entry for the next step
+	// while others still read this one
+	Array<number> dt_tile;
+	int dt_slot = 0;
+
+	// backs the shared fields above, global grid only
+	Arena arena;
+
+	// fused sweep scratch rows (tile local)
+	Array<number> Lprim_row;
+	Array<number> Lprim_next;
+	Array<number> Rprim_row;
+	Array<number> Lcons_row;
+	Array<number> Rcons_row;
+	Array<number> Lw_row;
+	Array<number> Rw_row;
+	Array<number> LJ_row;
+	Array<number> RJ_row;
+	Array<number> prim_tile;
+	Array<number> J_tile;
+
 	Grid(number &time, number &dt, number &step_time, number &step_dt);
 
 	// set grid properties
@@ -89,24 +128,47 @@ public:
 
 	// setup
 	void AllocGrid();
+	void AllocFields(Arena &from);
+	void AllocScratch();
+	void FirstTouch();
 	void AttachReference(Grid &g);
 	void DetachReference();
+	void RotateState();
 	void InitUVCoord();
 
 	// setup prim
 	void InitCond();
 
 	void ConsLim();
+	void ConsLim(int iil, int iiu, int jjl, int jju);
+	void ConsLimGhost();
+	void ConsLimRow(number *cons, number *prim, int stride, int kl, int ku);
 	void ConsToPrim();
 	void PointPrimToCons(const Array<number> &prim, Array<number> &cons);
 	void PrimLim(Array<number> &prim);
+	void PrimLimRow(number *prim, int stride, int kl, int ku);
 	void PrimToCons(const Array<number> &prim, Array<number> &cons);
+	void PrimToConsRow(const number *prim, number *cons, int stride, int kl, int ku);
 
 	void Reconstruct(int dir);
-	void Wavespeed(int dir);
+	template<int order> void ReconstructRow(const number *q, int stride,
+		number *ql, number *qr, int kl, int ku);
+	void Wavespeed(int dir, bool find_dt);
+	template<int dir> void WavespeedRow(const number *Lprim, const number *Rprim, int stride,
+		const number *Lcell, const number *Rcell, int cell_stride,
+		number *Lw, number *Rw, int kl, int ku);
+	void PrimToConsFlux(int dir, const Array<number> &prim, Array<number> &cons, Array<number> &J);
+	template<int dir> void PrimToConsFluxRow(const number *prim, number *cons,
+		number *J, int stride, int kl, int ku);
 	void CalculateSrc();
-	void DetermineDt(int dir);
-	void CalculateFluxDiv();
+	void CellDt();
+	void CombineDt();
+
+	// fused reconstruct through riemann flux, one row at a time
+	void Sweep(int dir, bool find_dt, int kl, int ku);
+	template<int order, int solver, int dir> void SweepDir(bool find_dt, int kl, int ku);
+	template<int order, int solver, int dir> number SweepPencil(const number *q, int stride,
+		number *J, int Jstride, int kl, int ku, bool find_dt);
 
 	// boundary
 	void Boundary(number time);
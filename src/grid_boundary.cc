@@ -6,37 +6,54 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/.
  */
 
+#include <cstring>
+
 #include "grid.hh"
 
+/*
+ * Every routine only fills the ghost cells adjacent to this grid's own cells
+ * [il, iu) x [jl, ju), and returns if they do not touch that side of the
+ * domain, so each thread can fill its share of ghosts concurrently. Only
+ * nonghost cells are read.
+ */
+
 void Grid::PeriodicBoundaryLeft()
 {
+	if (il != NGHOST) {
+		return;
+	}
+
 	int i = 0;
 	for (int m = 0; m < NQUANT; m++) {
 		for (int k = 0; k < NGHOST; k++) {
-			for (int j = NGHOST; j < nv-NGHOST; j++) {
-				cons(m,i+k,j) = cons(m,nu-2*NGHOST+k,j);
-			}
+			memcpy(&cons(m,i+k,jl), &cons(m,nu-2*NGHOST+k,jl), (ju-jl)*sizeof(number));
 		}
 	}
 }
 
 void Grid::PeriodicBoundaryRight()
 {
+	if (iu != nu-NGHOST) {
+		return;
+	}
+
 	int i = nu-1;
 	for (int m = 0; m < NQUANT; m++) {
 		for (int k = 0; k < NGHOST; k++) {
-			for (int j = NGHOST; j < nv-NGHOST; j++) {
-				cons(m,i-k,j) = cons(m,2*NGHOST-1-k,j);
-			}
+			memcpy(&cons(m,i-k,jl), &cons(m,2*NGHOST-1-k,jl), (ju-jl)*sizeof(number));
 		}
 	}
 }
 
 void Grid::PeriodicBoundaryBot()
 {
+	if (jl != NGHOST) {
+		return;
+	}
+
 	int j = 0;
 	for (int m = 0; m < NQUANT; m++) {
-		for (int i = NGHOST; i < nu-NGHOST; i++) {
+		for (int i = il; i < iu; i++) {
 			for (int k = 0; k < NGHOST; k++) {
 				cons(m,i,j+k) = cons(m,i,nv-2*NGHOST+k);
 			}
@@ -46,9 +63,13 @@ void Grid::PeriodicBoundaryBot()
 
 void Grid::PeriodicBoundaryTop()
 {
+	if (ju != nv-NGHOST) {
+		return;
+	}
+
 	int j = nv-1;
 	for (int m = 0; m < NQUANT; m++) {
-		for (int i = NGHOST; i < nu-NGHOST; i++) {
+		for (int i = il; i < iu; i++) {
 			for (int k = 0; k < NGHOST; k++) {
 				cons(m,i,j-k) = cons(m,i,2*NGHOST-1-k);
 			}
@@ -58,6 +79,10 @@ void Grid::PeriodicBoundaryTop()
 
 void Grid::PeriodicBoundaryLB()
 {
+	if (il != NGHOST || jl != NGHOST) {
+		return;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
 		for (int i = 0; i < NGHOST; i++) {
 			for (int j = 0; j < NGHOST; j++) {
@@ -69,6 +94,10 @@ void Grid::PeriodicBoundaryLB()
 
 void Grid::PeriodicBoundaryRB()
 {
+	if (iu != nu-NGHOST || jl != NGHOST) {
+		return;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
 		for (int i = 0; i < NGHOST; i++) {
 			for (int j = 0; j < NGHOST; j++) {
@@ -80,6 +109,10 @@ void Grid::PeriodicBoundaryRB()
 
 void Grid::PeriodicBoundaryRT()
 {
+	if (iu != nu-NGHOST || ju != nv-NGHOST) {
+		return;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
 		for (int i = 0; i < NGHOST; i++) {
 			for (int j = 0; j < NGHOST; j++) {
@@ -91,6 +124,10 @@ void Grid::PeriodicBoundaryRT()
 
 void Grid::PeriodicBoundaryLT()
 {
+	if (il != NGHOST || ju != nv-NGHOST) {
+		return;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
 		for (int i = 0; i < NGHOST; i++) {
 			for (int j = 0; j < NGHOST; j++) {
@@ -102,15 +139,19 @@ void Grid::PeriodicBoundaryLT()
 
 void Grid::InflowBoundaryLeft(number rho, number vx, number vy, number press)
 {
+	if (il != NGHOST) {
+		return;
+	}
+
 	Array<number> tmp_prim{NQUANT};
 	Array<number> tmp_cons{NQUANT};
 	tmp_prim(0) = rho;
 	tmp_prim(1) = vx;
 	tmp_prim(2) = vy;
 	tmp_prim(3) = press;
+	PointPrimToCons(tmp_prim, tmp_cons);
 	for (int k = 0; k < NGHOST; k++) {
-		for (int j = NGHOST; j < nv-NGHOST; j++) {
-			PointPrimToCons(tmp_prim, tmp_cons);
+		for (int j = jl; j < ju; j++) {
 			cons(0,k,j) = tmp_cons(0);
 			cons(1,k,j) = tmp_cons(1);
 			cons(2,k,j) = tmp_cons(2);
@@ -121,6 +162,10 @@ void Grid::InflowBoundaryLeft(number rho, number vx, number vy, number press)
 
 void Grid::InflowBoundaryRight(number rho, number vx, number vy, number press)
 {
+	if (iu != nu-NGHOST) {
+		return;
+	}
+
 	int i = nu-1;
 	Array<number> tmp_prim{NQUANT};
 	Array<number> tmp_cons{NQUANT};
@@ -128,9 +173,9 @@ void Grid::InflowBoundaryRight(number rho, number vx, number vy, number press)
 	tmp_prim(1) = vx;
 	tmp_prim(2) = vy;
 	tmp_prim(3) = press;
+	PointPrimToCons(tmp_prim, tmp_cons);
 	for (int k = 0;  k < NGHOST; k++) {
-		for (int j = NGHOST; j < nv-NGHOST; j++) {
-			PointPrimToCons(tmp_prim, tmp_cons);
+		for (int j = jl; j < ju; j++) {
 			prim(0,i-k,j) = tmp_cons(0);
 			prim(1,i-k,j) = tmp_cons(1);
 			prim(2,i-k,j) = tmp_cons(2);
@@ -141,15 +186,19 @@ void Grid::InflowBoundaryRight(number rho, number vx, number vy, number press)
 
 void Grid::InflowBoundaryBot(number rho, number vx, number vy, number press)
 {
+	if (jl != NGHOST) {
+		return;
+	}
+
 	Array<number> tmp_prim{NQUANT};
 	Array<number> tmp_cons{NQUANT};
 	tmp_prim(0) = rho;
 	tmp_prim(1) = vx;
 	tmp_prim(2) = vy;
 	tmp_prim(3) = press;
-	for (int i = NGHOST; i < nu-NGHOST; i++) {
+	PointPrimToCons(tmp_prim, tmp_cons);
+	for (int i = il; i < iu; i++) {
 		for (int k = 0;  k < NGHOST; k++) {
-			PointPrimToCons(tmp_prim, tmp_cons);
 			prim(0,i,k) = tmp_cons(0);
 			prim(1,i,k) = tmp_cons(1);
 			prim(2,i,k) = tmp_cons(2);
@@ -160,6 +209,10 @@ void Grid::InflowBoundaryBot(number rho, number vx, number vy, number press)
 
 void Grid::InflowBoundaryTop(number rho, number vx, number vy, number press)
 {
+	if (ju != nv-NGHOST) {
+		return;
+	}
+
 	int j = nv-1;
 	Array<number> tmp_prim{NQUANT};
 	Array<number> tmp_cons{NQUANT};
@@ -167,9 +220,9 @@ void Grid::InflowBoundaryTop(number rho, number vx, number vy, number press)
 	tmp_prim(1) = vx;
 	tmp_prim(2) = vy;
 	tmp_prim(3) = press;
-	for (int i = NGHOST; i < nu-NGHOST; i++) {
+	PointPrimToCons(tmp_prim, tmp_cons);
+	for (int i = il; i < iu; i++) {
 		for (int k = 0;  k < NGHOST; k++) {
-			PointPrimToCons(tmp_prim, tmp_cons);
 			prim(0,i,j-k) = tmp_cons(0);
 			prim(1,i,j-k) = tmp_cons(1);
 			prim(2,i,j-k) = tmp_cons(2);
@@ -180,31 +233,39 @@ void Grid::InflowBoundaryTop(number rho, number vx, number vy, number press)
 
 void Grid::SmoothBoundaryLeft()
 {
+	if (il != NGHOST) {
+		return;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
 		for (int k = 0;  k < NGHOST; k++) {
-			for (int j = NGHOST; j < nv-NGHOST; j++) {
-				cons(m,k,j) = cons(m,NGHOST,j);
-			}
+			memcpy(&cons(m,k,jl), &cons(m,NGHOST,jl), (ju-jl)*sizeof(number));
 		}
 	}
 }
 
 void Grid::SmoothBoundaryRight()
 {
+	if (iu != nu-NGHOST) {
+		return;
+	}
+
 	int i = nu-1;
 	for (int m = 0; m < NQUANT; m++) {
 		for (int k = 0;  k < NGHOST; k++) {
-			for (int j = NGHOST; j < nv-NGHOST; j++) {
-				cons(m,i-k,j) = cons(m,nu-NGHOST-1,j);
-			}
+			memcpy(&cons(m,i-k,jl), &cons(m,nu-NGHOST-1,jl), (ju-jl)*sizeof(number));
 		}
 	}
 }
 
 void Grid::SmoothBoundaryBot()
 {
+	if (jl != NGHOST) {
+		return;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
-		for (int i = NGHOST; i < nu-NGHOST; i++) {
+		for (int i = il; i < iu; i++) {
 			for (int k = 0; k < NGHOST; k++) {
 				cons(m,i,k) = cons(m,i,NGHOST);
 			}
@@ -214,9 +275,13 @@ void Grid::SmoothBoundaryBot()
 
 void Grid::SmoothBoundaryTop()
 {
+	if (ju != nv-NGHOST) {
+		return;
+	}
+
 	int j = nv-1;
 	for (int m = 0; m < NQUANT; m++) {
-		for (int i = NGHOST; i < nu-NGHOST; i++) {
+		for (int i = il; i < iu; i++) {
 			for (int k = 0; k < NGHOST; k++) {
 				cons(m,i,j-k) = cons(m,i,nv-NGHOST-1);
 			}
@@ -226,6 +291,10 @@ void Grid::SmoothBoundaryTop()
 
 void Grid::SmoothBoundaryLB()
 {
+	if (il != NGHOST || jl != NGHOST) {
+		return;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
 		for (int i = 0; i < NGHOST; i++) {
 			for (int j = 0; j < NGHOST; j++) {
@@ -237,6 +306,10 @@ void Grid::SmoothBoundaryLB()
 
 void Grid::SmoothBoundaryRB()
 {
+	if (iu != nu-NGHOST || jl != NGHOST) {
+		return;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
 		for (int i = 0; i < NGHOST; i++) {
 			for (int j = 0; j < NGHOST; j++) {
@@ -248,6 +321,10 @@ void Grid::SmoothBoundaryRB()
 
 void Grid::SmoothBoundaryRT()
 {
+	if (iu != nu-NGHOST || ju != nv-NGHOST) {
+		return;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
 		for (int i = 0; i < NGHOST; i++) {
 			for (int j = 0; j < NGHOST; j++) {
@@ -259,6 +336,10 @@ void Grid::SmoothBoundaryRT()
 
 void Grid::SmoothBoundaryLT()
 {
+	if (il != NGHOST || ju != nv-NGHOST) {
+		return;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
 		for (int i = 0; i < NGHOST; i++) {
 			for (int j = 0; j < NGHOST; j++) {
@@ -270,8 +351,12 @@ void Grid::SmoothBoundaryLT()
 
 void Grid::ReflectingBoundaryLeft()
 {
+	if (il != NGHOST) {
+		return;
+	}
+
 	for (int k = 0;  k < NGHOST; k++) {
-		for (int j = NGHOST; j < nv-NGHOST; j++) {
+		for (int j = jl; j < ju; j++) {
 			cons(0,k,j) = cons(0,2*NGHOST-1-k,j);
 			cons(1,k,j) = -1 * cons(1,2*NGHOST-1-k,j);
 			cons(2,k,j) = cons(2,2*NGHOST-1-k,j);
@@ -282,9 +367,13 @@ void Grid::ReflectingBoundaryLeft()
 
 void Grid::ReflectingBoundaryRight()
 {
+	if (iu != nu-NGHOST) {
+		return;
+	}
+
 	int i = nu-1;
 	for (int k = 0;  k < NGHOST; k++) {
-		for (int j = NGHOST; j < nv-NGHOST; j++) {
+		for (int j = jl; j < ju; j++) {
 			cons(0,i-k,j) = cons(0,i-2*NGHOST+1+k,j);
 			cons(1,i-k,j) = -1 * cons(1,i-2*NGHOST+1+k,j);
 			cons(2,i-k,j) = cons(2,i-2*NGHOST+1+k,j);
@@ -295,7 +384,11 @@ void Grid::ReflectingBoundaryRight()
 
 void Grid::ReflectingBoundaryBot()
 {
-	for (int i = NGHOST; i < nu-NGHOST; i++) {
+	if (jl != NGHOST) {
+		return;
+	}
+
+	for (int i = il; i < iu; i++) {
 		for (int k = 0;  k < NGHOST; k++) {
 			cons(0,i,k) = cons(0,i,2*NGHOST-1-k);
 			cons(1,i,k) = cons(1,i,2*NGHOST-1-k);
@@ -307,8 +400,12 @@ void Grid::ReflectingBoundaryBot()
 
 void Grid::ReflectingBoundaryTop()
 {
+	if (ju != nv-NGHOST) {
+		return;
+	}
+
 	int j = nv-1;
-	for (int i = NGHOST; i < nu-NGHOST; i++) {
+	for (int i = il; i < iu; i++) {
 		for (int k = 0;  k < NGHOST; k++) {
 			cons(0,i,j-k) = cons(0,i,j-2*NGHOST+1+k);
 			cons(1,i,j-k) = cons(1,i,j-2*NGHOST+1+k);
@@ -320,6 +417,10 @@ void Grid::ReflectingBoundaryTop()
 
 void Grid::ReflectingBoundaryLB()
 {
+	if (il != NGHOST || jl != NGHOST) {
+		return;
+	}
+
 	for (int i = 0; i < NGHOST; i++) {
 		for (int j = 0; j < NGHOST; j++) {
 			cons(0,i,j) = cons(0,2*NGHOST-1-i,2*NGHOST-1-j);
@@ -332,6 +433,10 @@ void Grid::ReflectingBoundaryLB()
 
 void Grid::ReflectingBoundaryRB()
 {
+	if (iu != nu-NGHOST || jl != NGHOST) {
+		return;
+	}
+
 	for (int i = 0; i < NGHOST; i++) {
 		for (int j = 0; j < NGHOST; j++) {
 			cons(0,nu-1-i,j) = cons(0,nu-2*NGHOST+i,2*NGHOST-1-j);
@@ -344,6 +449,10 @@ void Grid::ReflectingBoundaryRB()
 
 void Grid::ReflectingBoundaryRT()
 {
+	if (iu != nu-NGHOST || ju != nv-NGHOST) {
+		return;
+	}
+
 	for (int i = 0; i < NGHOST; i++) {
 		for (int j = 0; j < NGHOST; j++) {
 			cons(0,nu-1-i,nv-1-j) = cons(0,nu-2*NGHOST+i,nv-2*NGHOST+j);
@@ -356,6 +465,10 @@ void Grid::ReflectingBoundaryRT()
 
 void Grid::ReflectingBoundaryLT()
 {
+	if (il != NGHOST || ju != nv-NGHOST) {
+		return;
+	}
+
 	for (int i = 0; i < NGHOST; i++) {
 		for (int j = 0; j < NGHOST; j++) {
 			cons(0,i,nv-1-j) = cons(0,2*NGHOST-1-i,nv-2*NGHOST+j);
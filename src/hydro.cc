@@ -6,16 +6,17 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/.
  */
 
+#include <cfloat>
 #include <cmath>
 
 #include "grid.hh"
 #include "riemann.hh"
 
 // for [0, lim)
-static void determine_loop_limits(int tid, int lim, int *iil, int *iiu)
+static void determine_loop_limits(int tid, int ntile, int lim, int *iil, int *iiu)
 {
 	if (tid >= 0) {
-		int nii = (lim + NTHREAD - 1) / NTHREAD;
+		int nii = (lim + ntile - 1) / ntile;
 		*iil = tid * nii;
 		*iiu = std::min((tid + 1)*nii, lim);
 	} else {
@@ -25,32 +26,136 @@ static void determine_loop_limits(int tid, int lim, int *iil, int *iiu)
 	}
 }
 
+/*
+ * cons to floored prim in one pass: own cells for tile local grids, whole
+ * grid for the global grid
+ */
 void Grid::ConsLim()
 {
-	ConsToPrim();
-	PrimLim(prim);
-	PrimToCons(prim, cons);
+	int iil, iiu, jjl, jju;
+
+	if (tid >= 0) {
+		iil = il;
+		iiu = iu;
+		jjl = jl;
+		jju = ju;
+	} else {
+		iil = 0;
+		iiu = nu;
+		jjl = 0;
+		jju = nv;
+	}
+
+	ConsLim(iil, iiu, jjl, jju);
+}
+
+// cons to floored prim for cells [iil, iiu) x [jjl, jju)
+void Grid::ConsLim(int iil, int iiu, int jjl, int jju)
+{
+	for (int i = iil; i < iiu; i++) {
+		ConsLimRow(&cons(0,i,0), &prim(0,i,0), cons.n[1]*cons.n[2], jjl, jju);
+	}
+}
+
+/*
+ * ConsLim for only the ghost cells this grid fills in Boundary, so no barrier
+ * is needed between the two
+ */
+void Grid::ConsLimGhost()
+{
+	const int stride = cons.n[1]*cons.n[2];
+	// edge ghosts plus the corners on this grid's side
+	const int jjl = (jl == NGHOST) ? 0 : jl;
+	const int jju = (ju == nv-NGHOST) ? nv : ju;
+
+	if (il == NGHOST) {
+		for (int i = 0; i < NGHOST; i++) {
+			ConsLimRow(&cons(0,i,0), &prim(0,i,0), stride, jjl, jju);
+		}
+	}
+	for (int i = il; i < iu; i++) {
+		if (jl == NGHOST) {
+			ConsLimRow(&cons(0,i,0), &prim(0,i,0), stride, 0, NGHOST);
+		}
+		if (ju == nv-NGHOST) {
+			ConsLimRow(&cons(0,i,0), &prim(0,i,0), stride, nv-NGHOST, nv);
+		}
+	}
+	if (iu == nu-NGHOST) {
+		for (int i = nu-NGHOST; i < nu; i++) {
+			ConsLimRow(&cons(0,i,0), &prim(0,i,0), stride, jjl, jju);
+		}
+	}
+}
+
+/*
+ * quantity m of cell k at cons/prim[m*stride + k]; cons is only written back
+ * where a floor was applied
+ */
+void Grid::ConsLimRow(number *cons, number *prim, int stride, int kl, int ku)
+{
+	for (int k = kl; k < ku; k++) {
+		number rho = cons[k];
+		number v1 = cons[stride + k] / rho;
+		number v2 = cons[2*stride + k] / rho;
+		number ke = 0.5 * rho * (SQR(v1) + SQR(v2));
+		number press = (cons[3*stride + k] - ke) * (gamma - 1);
+		bool floored = false;
+
+		for (int m = 4; m < NQUANT; m++) {
+			number q = cons[m*stride + k] / rho;
+			if (q < 0) {
+				q = 0;
+				floored = true;
+			}
+			prim[m*stride + k] = q;
+		}
+
+		if (rho < rho_floor) {
+			rho = rho_floor;
+			floored = true;
+		}
+		if (press < press_floor) {
+			press = press_floor;
+			floored = true;
+		}
+
+		prim[k] = rho;
+		prim[stride + k] = v1;
+		prim[2*stride + k] = v2;
+		prim[3*stride + k] = press;
+
+		if (floored) {
+			PrimToConsRow(prim, cons, stride, k, k+1);
+		}
+	}
 }
 
 void Grid::PrimLim(Array<number> &prim)
 {
 	int iil, iiu;
 
-	determine_loop_limits(tid, prim.n[1], &iil, &iiu);
+	determine_loop_limits(tid, ntile, prim.n[1], &iil, &iiu);
 	for (int i = iil; i < iiu; i++) {
-		for (int j = 0; j < prim.n[2]; j++) {
-			if (prim(0,i,j) < rho_floor) {
-				prim(0,i,j) = rho_floor;
-			}
+		PrimLimRow(&prim(0,i,0), prim.n[1]*prim.n[2], 0, prim.n[2]);
+	}
+}
 
-			if (prim(3,i,j) < press_floor) {
-				prim(3,i,j) = press_floor;
-			}
+// quantity m of point k at prim[m*stride + k]
+void Grid::PrimLimRow(number *prim, int stride, int kl, int ku)
+{
+	for (int k = kl; k < ku; k++) {
+		if (prim[k] < rho_floor) {
+			prim[k] = rho_floor;
+		}
 
-			for (int m = 4; m < NQUANT; m++) {
-				if (prim(m,i,j) < 0) {
-					prim(m,i,j) = 0;
-				}
+		if (prim[3*stride + k] < press_floor) {
+			prim[3*stride + k] = press_floor;
+		}
+
+		for (int m = 4; m < NQUANT; m++) {
+			if (prim[m*stride + k] < 0) {
+				prim[m*stride + k] = 0;
 			}
 		}
 	}
@@ -60,20 +165,28 @@ void Grid::PrimToCons(const Array<number> &prim, Array<number> &cons)
 {
 	int iil, iiu;
 
-	determine_loop_limits(tid, prim.n[1], &iil, &iiu);
+	determine_loop_limits(tid, ntile, prim.n[1], &iil, &iiu);
 	for (int i = iil; i < iiu; i++) {
-		for (int j = 0; j < prim.n[2]; j++) {
-			number rho = prim(0,i,j);
-			number vsquared = SQR(prim(1,i,j)) + SQR(prim(2,i,j));
+		PrimToConsRow(&prim(0,i,0), &cons(0,i,0), prim.n[1]*prim.n[2], 0, prim.n[2]);
+	}
+}
 
-			cons(0,i,j) = rho;
-			cons(1,i,j) = rho * prim(1,i,j);
-			cons(2,i,j) = rho * prim(2,i,j);
-			cons(3,i,j) = 0.5 * rho * vsquared + prim(3,i,j) / (gamma - 1);
+// quantity m of point k at prim[m*stride + k], cons[m*stride + k]
+void Grid::PrimToConsRow(const number *prim, number *cons, int stride, int kl, int ku)
+{
+	for (int k = kl; k < ku; k++) {
+		number rho = prim[k];
+		number v1 = prim[stride + k];
+		number v2 = prim[2*stride + k];
+		number vsquared = SQR(v1) + SQR(v2);
 
-			for (int m = 4; m < NQUANT; m++) {
-				cons(m,i,j) = rho * prim(m,i,j);
-			}
+		cons[k] = rho;
+		cons[stride + k] = rho * v1;
+		cons[2*stride + k] = rho * v2;
+		cons[3*stride + k] = 0.5 * rho * vsquared + prim[3*stride + k] / (gamma - 1);
+
+		for (int m = 4; m < NQUANT; m++) {
+			cons[m*stride + k] = rho * prim[m*stride + k];
 		}
 	}
 }
@@ -82,9 +195,9 @@ void Grid::ConsToPrim()
 {
 	int iil, iiu;
 
-	determine_loop_limits(tid, cons.n[1], &iil, &iiu);
+	determine_loop_limits(tid, ntile, cons.n[1], &iil, &iiu);
 	for (int i = iil; i < iiu; i++) {
-		for (int j = 0; j < cons.n[2]; j++) {
+		for (int j = 0; j < nv; j++) {
 			number rho = cons(0,i,j);
 			number v1 = cons(1,i,j) / rho;
 			number v2 = cons(2,i,j) / rho;
@@ -114,86 +227,189 @@ void Grid::PointPrimToCons(const Array<number> &prim, Array<number> &cons)
 	}
 }
 
-void Grid::Wavespeed(int dir)
+/*
+ * Lw/Rw for this tile's faces along dir and, if find_dt, this thread's
+ * minimum crossing time of nonghost cells bounded by them into dt_tile
+ */
+void Grid::Wavespeed(int dir, bool find_dt)
 {
-	int di, dj;
+	number tmin = DBL_MAX;
+
 	if (dir == 0) {
-		di = 1;
-		dj = 0;
+		for (int i = il; i < iuf; i++) {
+			// face loop
+			WavespeedRow<0>(&Lprim(0,i,0), &Rprim(0,i,0), Lprim.n[1]*Lprim.n[2],
+				&prim(0,i-1,0), &prim(0,i,0), prim.n[1]*prim.n[2],
+				&Lw(i,0), &Rw(i,0), jl, ju);
+
+			// faces bounding nonghost cells
+			for (int j = jl; find_dt && j < ju; j++) {
+				if (i < nu-NGHOST) {
+					tmin = fmin(tmin, du/fabs(Rw(i,j)));
+				}
+				if (i > NGHOST) {
+					tmin = fmin(tmin, du/fabs(Lw(i,j)));
+				}
+			}
+		}
 	} else {
-		di = 0;
-		dj = 1;
+		for (int i = il; i < iu; i++) {
+			// face loop
+			WavespeedRow<1>(&Lprim(0,i,0), &Rprim(0,i,0), Lprim.n[1]*Lprim.n[2],
+				&prim(0,i,0) - 1, &prim(0,i,0), prim.n[1]*prim.n[2],
+				&Lw(i,0), &Rw(i,0), jl, juf);
+
+			// faces bounding nonghost cells
+			for (int j = jl; find_dt && j < juf; j++) {
+				if (j < nv-NGHOST) {
+					tmin = fmin(tmin, dv/fabs(Rw(i,j)));
+				}
+				if (j > NGHOST) {
+					tmin = fmin(tmin, dv/fabs(Lw(i,j)));
+				}
+			}
+		}
+	}
+
+	if (find_dt) {
+		dt_tile(dt_slot, tid) = fmin(dt_tile(dt_slot, tid), tmin);
 	}
+}
+
+/*
+ * face k has reconstructed states Lprim/Rprim[m*stride + k] and neighboring
+ * cell centers Lcell/Rcell[m*cell_stride + k]
+ */
+template<int dir>
+void Grid::WavespeedRow(const number *Lprim, const number *Rprim, int stride,
+	const number *Lcell, const number *Rcell, int cell_stride,
+	number *Lw, number *Rw, int kl, int ku)
+{
+	const int p = 3*stride;
+	const int cp = 3*cell_stride;
+	const int v = (1+dir)*stride;
+	const int cv = (1+dir)*cell_stride;
+
+	for (int k = kl; k < ku; k++) {
+		number Lcs, Rcs, Lv, Rv;
 
-	for (int i = il; i < iuf; i++) {
-		// face loop
-		for (int j = jl; j < ju+1; j++) {
-			number Lcs, Rcs, Lv, Rv;
+		Lcs = fmax(sqrt(gamma * Lprim[p + k] / Lprim[k]), sqrt(gamma * Lcell[cp + k] / Lcell[k]));
+		Rcs = fmax(sqrt(gamma * Rprim[p + k] / Rprim[k]), sqrt(gamma * Rcell[cp + k] / Rcell[k]));
+		Lv = fmin(Lprim[v + k], Lcell[cv + k]);
+		Rv = fmax(Rprim[v + k], Rcell[cv + k]);
 
-			Lcs = fmax(sqrt(gamma * Lprim(3,i,j) / Lprim(0,i,j)), sqrt(gamma * prim(3,i-di,j-dj) / prim(0,i-di,j-dj)));
-			Rcs = fmax(sqrt(gamma * Rprim(3,i,j) / Rprim(0,i,j)), sqrt(gamma * prim(3,i,j) / prim(0,i,j)));
-			Lv = fmin(Lprim(1+dir,i,j), prim(1+dir,i-di,j-dj));
-			Rv = fmax(Rprim(1+dir,i,j), prim(1+dir,i,j));
+		Lw[k] = fmin(Lv - Lcs, Rv - Rcs);
+		Rw[k] = fmax(Lv + Lcs, Rv + Rcs);
+	}
+}
 
-			Lw(i,j) = fmin(Lv - Lcs, Rv - Rcs);
-			Rw(i,j) = fmax(Lv + Lcs, Rv + Rcs);
+template void Grid::WavespeedRow<0>(const number *, const number *, int,
+	const number *, const number *, int, number *, number *, int, int);
+template void Grid::WavespeedRow<1>(const number *, const number *, int,
+	const number *, const number *, int, number *, number *, int, int);
+
+// also physical flux along dir for riemann solvers that need it
+void Grid::PrimToConsFlux(int dir, const Array<number> &prim, Array<number> &cons, Array<number> &J)
+{
+	int iil, iiu;
+
+	determine_loop_limits(tid, ntile, prim.n[1], &iil, &iiu);
+	for (int i = iil; i < iiu; i++) {
+		if (dir == 0) {
+			PrimToConsFluxRow<0>(&prim(0,i,0), &cons(0,i,0), &J(0,i,0), prim.n[1]*prim.n[2], 0, prim.n[2]);
+		} else {
+			PrimToConsFluxRow<1>(&prim(0,i,0), &cons(0,i,0), &J(0,i,0), prim.n[1]*prim.n[2], 0, prim.n[2]);
+		}
+	}
+}
+
+// PrimToConsRow and physical flux along dir in one pass
+template<int dir>
+void Grid::PrimToConsFluxRow(const number *prim, number *cons, number *J, int stride, int kl, int ku)
+{
+	for (int k = kl; k < ku; k++) {
+		number rho = prim[k];
+		number v1 = prim[stride + k];
+		number v2 = prim[2*stride + k];
+		number press = prim[3*stride + k];
+		number vn = (dir == 0) ? v1 : v2;
+		number vsquared = SQR(v1) + SQR(v2);
+		number e;
+
+		e = 0.5 * rho * vsquared + press / (gamma - 1);
+
+		cons[k] = rho;
+		cons[stride + k] = rho * v1;
+		cons[2*stride + k] = rho * v2;
+		cons[3*stride + k] = e;
+
+		J[k] = rho * vn;
+		J[stride + k] = rho * v1 * vn;
+		J[2*stride + k] = rho * v2 * vn;
+		J[(1+dir)*stride + k] += press;
+		J[3*stride + k] = e * vn + press * vn;
+
+		for (int m = 4; m < NQUANT; m++) {
+			cons[m*stride + k] = rho * prim[m*stride + k];
+			J[m*stride + k] = rho * prim[m*stride + k] * vn;
 		}
 	}
 }
 
+template void Grid::PrimToConsFluxRow<0>(const number *, number *, number *, int, int, int);
+template void Grid::PrimToConsFluxRow<1>(const number *, number *, number *, int, int, int);
+
+// no source over this tile's cells, or the whole grid for the global grid
 void __attribute__((weak)) Grid::CalculateSrc()
 {
+	int iil, iiu, jjl, jju;
+
+	if (tid >= 0) {
+		iil = il;
+		iiu = iu;
+		jjl = jl;
+		jju = ju;
+	} else {
+		iil = 0;
+		iiu = nu;
+		jjl = 0;
+		jju = nv;
+	}
+
 	for (int m = 0; m < NQUANT; m++) {
-		for (int i = 0; i < nu; i++) {
-			for (int j = 0; j < nv; j++) {
+		for (int i = iil; i < iiu; i++) {
+			for (int j = jjl; j < jju; j++) {
 				src(m,i,j) = 0*prim(0)*cons(0)*time*dt;
 			}
 		}
 	}
 }
 
-void Grid::DetermineDt(int dir)
+// this tile's minimum 1D crossing time of cell centers into dt_tile
+void Grid::CellDt()
 {
-	int di, dj;
-	number ds;
-	if (dir == 0) {
-		di = 1;
-		dj = 0;
-		ds = du;
-	} else {
-		di = 0;
-		dj = 1;
-		ds = dv;
-	}
+	number tmin = DBL_MAX;
 
-	// not thread local
-	for (int i = NGHOST; i < nu-NGHOST; i++) {
+	for (int i = il; i < iu; i++) {
 		// cell loop
-		for (int j = NGHOST; j < nv-NGHOST; j++) {
-			number w1, w2;
-			number cross_time;
-
-			w1 = fabs(Rw(i,j));
-			w2 = fabs(Lw(i+di,j+dj));
+		for (int j = jl; j < ju; j++) {
+			number cs = sqrt(gamma * prim(3,i,j) / prim(0,i,j));
 
-			cross_time = fmin(ds/w1, ds/w2);
-
-			if (cross_time < dt) {
-				dt = cross_time;
-			}
+			tmin = fmin(tmin, du/(fabs(prim(1,i,j)) + cs));
+			tmin = fmin(tmin, dv/(fabs(prim(2,i,j)) + cs));
 		}
 	}
+
+	dt_tile(dt_slot, tid) = fmin(dt_tile(dt_slot, tid), tmin);
 }
 
-void Grid::CalculateFluxDiv()
+// dt from all tiles' crossing times in dt_slot, the same for every tile
+void Grid::CombineDt()
 {
-	for (int m = 0; m < NQUANT; m++) {
-		for (int i = il; i < iu; i++) {
-			// cell loop
-			for (int j = jl; j < ju; j++) {
-				fluxdiv(m,i,j) = (Ju(m,i,j) - Ju(m,i+1,j)) / du
-					+ (Jv(m,i,j) - Jv(m,i,j+1)) / dv;
-			}
+	dt = DBL_MAX;
+	for (int t = 0; t < dt_tile.n[1]; t++) {
+		if (dt_tile(dt_slot, t) < dt) {
+			dt = dt_tile(dt_slot, t);
 		}
 	}
 }
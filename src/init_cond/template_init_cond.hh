@@ -32,6 +32,15 @@ void Integrator::Property()
 	//RK2();
 	//SSPRK3();
 	SSPRK4();
+	//LowStorageSSPRK4();
+	// many stage: ssp coefficient nstage-1 and n^2-n for nstage = n^2
+	//ManyStageSSPRK2(4);
+	//ManyStageSSPRK3(9);
+
+	// or cfl_num = RecommendedCfl();
+
+	// dimensionally split x/y substeps, cfl_num is then per direction
+	strang_split = false;
 
 	// autocompute
 	out_dt = out_tf / (max_out - 1);
@@ -42,6 +51,9 @@ void Grid::Property()
 	// 1: 1st order no reconstruction, 2: 2nd order linear, 3: 4th order parabolic
 	reconstruct_order = 3;
 
+	// riemann solver: SOLVER_HLLC or SOLVER_HLLE
+	riemann_solver = SOLVER_HLLC;
+
 	// floors
 	rho_floor = 1e-8;
 	press_floor = 1e-10;
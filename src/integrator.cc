@@ -9,50 +9,150 @@
 #include "integrator.hh"
 
 #include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 
+/*
+ * time of the state after stage i in units of dt after the step start,
+ * following cons_gen too for low storage schemes that overwrite it
+ */
 void Integrator::ComputeTimeWeight()
 {
+	number t = 0;
+	number tgen = 0;
+
 	time_weight = Array<number>{nstep};
 
 	for (int i = 0; i < nstep; i++) {
-		time_weight(i) = (weight(i,1) + weight(i,2)) / (weight(i,0) + weight(i,1));
+		number tnew = (weight(i,0)*tgen + weight(i,1)*t + weight(i,2)) / (weight(i,0) + weight(i,1));
+
+		if (i == gen_step) {
+			tgen = (gen_weight(0)*tgen + gen_weight(1)*t + gen_weight(2)) / (gen_weight(0) + gen_weight(1));
+		}
+
+		t = tnew;
+		time_weight(i) = t;
 	}
 }
 
-void Integrator::AddFluxDivSrc(Grid *g)
+/*
+ * Applies stage s to cells [il, iu) x [jl, ju) of this thread's tile, with
+ * the flux divergence taken from Ju/Jv on the fly. One dispatch per stage to
+ * an UpdateStage specialized on what the stage does besides the Shu-Osher
+ * update.
+ *
+ * Instead of copying cons to cons_gen, the caller swaps them with
+ * Grid::RotateState before stage 0, which then reads the step's initial
+ * state from cons_gen, where the later stages need it, and writes its result
+ * to cons.
+ */
+void Integrator::AddFluxDivSrc(Grid *g, int s, int dir, int il, int iu, int jl, int ju)
 {
-	int il = g->il;
-	int iu = g->iu;
-	int jl = g->jl;
-	int ju = g->ju;
+	if (dir == 0) {
+		AddFluxDivSrcDir<0>(g, s, il, iu, jl, ju);
+	} else if (dir == 1) {
+		AddFluxDivSrcDir<1>(g, s, il, iu, jl, ju);
+	} else {
+		AddFluxDivSrcDir<2>(g, s, il, iu, jl, ju);
+	}
+}
+
+template<int dir>
+void Integrator::AddFluxDivSrcDir(Grid *g, int s, int il, int iu, int jl, int ju)
+{
+	if (s == 0 && gen_step == 0) {
+		UpdateStage<STAGE_FIRST_LOW_STORAGE,dir>(g, s, il, iu, jl, ju);
+	} else if (s == 0) {
+		UpdateStage<STAGE_FIRST,dir>(g, s, il, iu, jl, ju);
+	} else if (s == gen_step) {
+		UpdateStage<STAGE_LOW_STORAGE,dir>(g, s, il, iu, jl, ju);
+	} else if (ssprk4 && s == 1) {
+		UpdateStage<STAGE_RK4_U2,dir>(g, s, il, iu, jl, ju);
+	} else if (ssprk4 && s == 2) {
+		UpdateStage<STAGE_RK4_U3,dir>(g, s, il, iu, jl, ju);
+	} else if (ssprk4 && s == 3) {
+		UpdateStage<STAGE_RK4_DERIV3,dir>(g, s, il, iu, jl, ju);
+	} else if (ssprk4 && s == 4) {
+		UpdateStage<STAGE_RK4_FINAL,dir>(g, s, il, iu, jl, ju);
+	} else {
+		UpdateStage<STAGE_SHU_OSHER,dir>(g, s, il, iu, jl, ju);
+	}
+}
+
+/*
+ * dir 0 or 1 takes only that direction's flux divergence for a split
+ * substep, and half the source since both substeps apply it, dir 2 takes both
+ */
+template<int kind, int dir>
+void Integrator::UpdateStage(Grid *g, int s, int il, int iu, int jl, int ju)
+{
+	const number idu = 1 / g->du;
+	const number idv = 1 / g->dv;
+	const number dt = g->dt;
+	const number src_weight = (dir == 2) ? 1 : 0.5;
+
+	// stage weights hoisted out of the cell loops
+	const number w0 = weight(s,0);
+	const number w1 = weight(s,1);
+	const number w2 = weight(s,2) * dt;
+	number g0 = 0, g1 = 0, g2 = 0;
+	number f0 = 0, f1 = 0, f2 = 0;
+
+	if (kind == STAGE_LOW_STORAGE || kind == STAGE_FIRST_LOW_STORAGE) {
+		g0 = gen_weight(0);
+		g1 = gen_weight(1);
+		g2 = gen_weight(2) * dt;
+	}
+	if (kind == STAGE_RK4_FINAL) {
+		f0 = rk4_fin_weight(0);
+		f1 = rk4_fin_weight(1);
+		f2 = rk4_fin_weight(2) * dt;
+	}
 
 	for (int m = 0; m < NQUANT; m++) {
 		for (int i = il; i < iu; i++) {
+			const number *Jul = &g->Ju(m,i,0);
+			const number *Juu = &g->Ju(m,i+1,0);
+			const number *Jv = &g->Jv(m,i,0);
+			const number *src = &g->src(m,i,0);
+			number *cons = &g->cons(m,i,0);
+			number *gen = &g->cons_gen(m,i,0);
+
 			// cell loop
 			for (int j = jl; j < ju; j++) {
 				number deriv;
 
-				deriv = g->fluxdiv(m,i,j) + g->src(m,i,j);
+				number div_u = (dir != 1) ? (Jul[j] - Juu[j]) * idu : 0;
+				number div_v = (dir != 0) ? (Jv[j] - Jv[j+1]) * idv : 0;
 
-				g->cons(m,i,j) = weight(s,0)*g->cons_gen(m,i,j) + weight(s,1)*g->cons(m,i,j) + weight(s,2)*deriv*g->dt;
+				deriv = div_u + div_v + src_weight * src[j];
 
-				// ssprk4 logic
-				if (ssprk4) {
-					if (s == 1) {
-						rk4_u2(m,i,j) = g->cons(m,i,j);
-					}
-					if (s == 2) {
-						rk4_u3(m,i,j) = g->cons(m,i,j);
-					}
-					if (s == 3) {
-						rk4_deriv3(m,i,j) = deriv;
-					}
-					if (s == 4) {
-						g->cons(m,i,j) += rk4_fin_weight(0) * rk4_u2(m,i,j)
-							+ rk4_fin_weight(1) * rk4_u3(m,i,j)
-							+ rk4_fin_weight(2) * rk4_deriv3(m,i,j) * g->dt;
+				if (kind == STAGE_FIRST || kind == STAGE_FIRST_LOW_STORAGE) {
+					number u = (w0 + w1)*gen[j] + w2*deriv;
+
+					if (kind == STAGE_FIRST_LOW_STORAGE) {
+						gen[j] = (g0 + g1)*gen[j] + g2*deriv;
 					}
+					cons[j] = u;
+					continue;
+				}
+
+				number u = w0*gen[j] + w1*cons[j] + w2*deriv;
+
+				if (kind == STAGE_LOW_STORAGE) {
+					gen[j] = g0*gen[j] + g1*cons[j] + g2*deriv;
+				} else if (kind == STAGE_RK4_U2) {
+					rk4_u2(m,i,j) = u;
+				} else if (kind == STAGE_RK4_U3) {
+					rk4_u3(m,i,j) = u;
+				} else if (kind == STAGE_RK4_DERIV3) {
+					rk4_deriv3(m,i,j) = deriv;
+				} else if (kind == STAGE_RK4_FINAL) {
+					u += f0*rk4_u2(m,i,j) + f1*rk4_u3(m,i,j) + f2*rk4_deriv3(m,i,j);
 				}
+
+				cons[j] = u;
 			}
 		}
 	}
@@ -60,6 +160,7 @@ void Integrator::AddFluxDivSrc(Grid *g)
 
 void Integrator::Euler()
 {
+	ssp_coef = 1;
 	nstep = 1;
 	weight = Array<number>{nstep, 3};
 
@@ -72,6 +173,7 @@ void Integrator::Euler()
 
 void Integrator::RK2()
 {
+	ssp_coef = 1;
 	nstep = 2;
 	weight = Array<number>{nstep, 3};
 
@@ -88,6 +190,7 @@ void Integrator::RK2()
 
 void Integrator::SSPRK3()
 {
+	ssp_coef = 1;
 	nstep = 3;
 	weight = Array<number>{nstep, 3};
 
@@ -109,6 +212,7 @@ void Integrator::SSPRK3()
 void Integrator::SSPRK4()
 {
 	ssprk4 = true;
+	ssp_coef = 1.508;
 	nstep = 5;
 	weight = Array<number>{nstep, 3};
 
@@ -138,9 +242,122 @@ void Integrator::SSPRK4()
 	rk4_fin_weight(1) = 0.096059710526147; // u3
 	rk4_fin_weight(2) = 0.063692468666290; // du3
 
-	rk4_u2 = Array<number>{NQUANT, NU + 2*NGHOST, NV + 2*NGHOST};
-	rk4_u3 = Array<number>{NQUANT, NU + 2*NGHOST, NV + 2*NGHOST};
-	rk4_deriv3 = Array<number>{NQUANT, NU + 2*NGHOST, NV + 2*NGHOST};
+	// registers in their own arena, same row padding as the grid
+	const int nu = NU + 2*NGHOST;
+	const int nvc = Arena::pad_row<number>(NV + 2*NGHOST);
+	rk4_arena.reserve(3 * Arena::round_up(NQUANT*nu*nvc*sizeof(number), ARENA_ALIGN));
+	rk4_u2 = Array<number>{rk4_arena, NQUANT, nu, nvc};
+	rk4_u3 = Array<number>{rk4_arena, NQUANT, nu, nvc};
+	rk4_deriv3 = Array<number>{rk4_arena, NQUANT, nu, nvc};
 
 	ComputeTimeWeight();
 }
+
+/*
+ * every stage a forward Euler step of dt/r from the previous one, the many
+ * stage schemes below then replace the rows that combine registers
+ */
+void Integrator::EulerChain(int nstage, number r)
+{
+	nstep = nstage;
+	weight = Array<number>{nstep, 3};
+
+	for (int i = 0; i < nstep; i++) {
+		weight(i,0) = 0;
+		weight(i,1) = 1;
+		weight(i,2) = 1 / r;
+	}
+
+	weight(0,0) = 1;
+	weight(0,1) = 0;
+}
+
+/*
+ * Ketcheson's SSPRK(10,4) in 2 registers: cons and cons_gen, which holds the
+ * step's initial state until stage 4 overwrites it. SSP coefficient 6, so
+ * cfl_num can be up to 6 times that of Euler() for 10 flux evaluations.
+ */
+void Integrator::LowStorageSSPRK4()
+{
+	ssp_coef = 6;
+	EulerChain(10, 6);
+
+	weight(4,0) = 3.0/5.0;
+	weight(4,1) = 2.0/5.0;
+	weight(4,2) = 1.0/15.0;
+
+	weight(9,0) = 2.0/5.0;
+	weight(9,1) = 3.0/5.0;
+	weight(9,2) = 1.0/10.0;
+
+	gen_step = 4;
+	gen_weight = Array<number>{3};
+
+	gen_weight(0) = 1.0/10.0;
+	gen_weight(1) = 9.0/10.0;
+	gen_weight(2) = 3.0/20.0;
+
+	ComputeTimeWeight();
+}
+
+// SSPRK(s,2) with SSP coefficient s-1
+void Integrator::ManyStageSSPRK2(int nstage)
+{
+	if (nstage < 2) {
+		printf("Bad ManyStageSSPRK2 nstage\n");
+		exit(EXIT_FAILURE);
+	}
+
+	ssp_coef = nstage - 1;
+	EulerChain(nstage, nstage - 1);
+
+	weight(nstep-1,0) = 1.0 / nstage;
+	weight(nstep-1,1) = (nstage - 1.0) / nstage;
+	weight(nstep-1,2) = 1.0 / nstage;
+
+	ComputeTimeWeight();
+}
+
+/*
+ * Ketcheson's SSPRK(n^2,3) with SSP coefficient n^2-n in 2 registers:
+ * cons_gen keeps the state after stage (n-1)(n-2)/2 for the one combining
+ * stage n(n+1)/2
+ */
+void Integrator::ManyStageSSPRK3(int nstage)
+{
+	int n = (int)lround(sqrt(nstage));
+
+	if (n < 2 || n*n != nstage) {
+		printf("Bad ManyStageSSPRK3 nstage\n");
+		exit(EXIT_FAILURE);
+	}
+
+	const number r = n*n - n;
+	const int nkeep = (n-1)*(n-2)/2;
+	const int c = n*(n+1)/2 - 1;
+
+	ssp_coef = r;
+	EulerChain(nstage, r);
+
+	weight(c,0) = n / (2.0*n - 1);
+	weight(c,1) = (n - 1) / (2.0*n - 1);
+	weight(c,2) = (n - 1) / ((2.0*n - 1) * r);
+
+	// cons_gen is already the initial state if nkeep is 0
+	if (nkeep > 0) {
+		gen_step = nkeep - 1;
+		gen_weight = Array<number>{3};
+
+		gen_weight(0) = 0;
+		gen_weight(1) = 1;
+		gen_weight(2) = 1 / r;
+	}
+
+	ComputeTimeWeight();
+}
+
+// largest stable cfl_num expected for the chosen scheme
+number Integrator::RecommendedCfl()
+{
+	return CFL_EULER * ssp_coef;
+}
@@ -11,14 +11,33 @@
 
 #include "grid.hh"
 
+// what a stage does besides the Shu-Osher update of cons
+enum StageKind {
+	STAGE_FIRST, // reads cons_gen, see AddFluxDivSrc
+	STAGE_FIRST_LOW_STORAGE,
+	STAGE_SHU_OSHER,
+	STAGE_LOW_STORAGE, // also overwrites cons_gen
+	STAGE_RK4_U2,
+	STAGE_RK4_U3,
+	STAGE_RK4_DERIV3,
+	STAGE_RK4_FINAL
+};
+
 class Integrator {
 public:
-	int s;
 	int nstep;
 	Array<number> weight;
 	Array<number> time_weight;
 
 	number cfl_num;
+	// strong stability preserving coefficient of the scheme
+	number ssp_coef;
+
+	// dimensionally split: every step does the rk stages with x then y
+	// fluxes only, or y then x on alternate steps, with a 1D cfl_num
+	bool strang_split = false;
+	// direction of the first step, each thread alternates its own copy
+	int split_dir = 0;
 
 	int max_epoch;
 	int max_out;
@@ -27,11 +46,17 @@ public:
 
 	// ssprk4
 	bool ssprk4 = false;
+	Arena rk4_arena;
 	Array<number> rk4_fin_weight;
 	Array<number> rk4_u2;
 	Array<number> rk4_u3;
 	Array<number> rk4_deriv3;
 
+	// 2 register low storage schemes also overwrite cons_gen after stage
+	// gen_step with gen_weight applied like weight(gen_step,.)
+	int gen_step = -1;
+	Array<number> gen_weight;
+
 	void Property();
 
 	void ComputeTimeWeight();
@@ -40,8 +65,16 @@ public:
 	void RK2();
 	void SSPRK3();
 	void SSPRK4();
+	void EulerChain(int nstage, number r);
+	void LowStorageSSPRK4();
+	void ManyStageSSPRK2(int nstage);
+	void ManyStageSSPRK3(int nstage);
+
+	number RecommendedCfl();
 
-	void AddFluxDivSrc(Grid *g);
+	void AddFluxDivSrc(Grid *g, int s, int dir, int il, int iu, int jl, int ju);
+	template<int dir> void AddFluxDivSrcDir(Grid *g, int s, int il, int iu, int jl, int ju);
+	template<int kind, int dir> void UpdateStage(Grid *g, int s, int il, int iu, int jl, int ju);
 };
 
 #endif /* INTEGRATOR_H */
@@ -6,203 +6,855 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
 #include <thread>
 #include <memory>
 #include <vector>
+#include <cstdlib>
+#include <unistd.h>
 
+#include "affinity.hh"
 #include "barrier.hh"
 #include "grid.hh"
 #include "riemann.hh"
 #include "integrator.hh"
 #include "broadcast.hh"
 
+// of the global grid, published by tile 0 after each step
 number global_time;
 number dt;
 number step_time;
 number step_dt;
 
-number out_time;
+/*
+ * ntile_u x ntile_v = ntile tiles of the nonghost nu x nv cells, from
+ * TILE_NU/TILE_NV or else the factorization with the least halo perimeter.
+ * Tiles are at least 2*NGHOST wide so stencils and ghost fills never reach
+ * past the adjacent tiles, which are the only ones a tile syncs with.
+ */
+static void choose_tiles(int ntile, int nu, int nv, int *ntile_u, int *ntile_v)
+{
+	if (TILE_NU > 0 && TILE_NV > 0) {
+		if (TILE_NU * TILE_NV != ntile) {
+			printf("TILE_NU * TILE_NV must equal the number of tiles\n");
+			exit(EXIT_FAILURE);
+		}
+		if (TILE_NU > nu / (2*NGHOST) || TILE_NV > nv / (2*NGHOST)) {
+			printf("cannot tile %d x %d cells into %d x %d tiles\n", nu, nv, TILE_NU, TILE_NV);
+			exit(EXIT_FAILURE);
+		}
+		*ntile_u = TILE_NU;
+		*ntile_v = TILE_NV;
+		return;
+	}
 
-class IntegratorThread {
+	number best = DBL_MAX;
+	*ntile_u = 1;
+	*ntile_v = 1;
+	for (int p = 1; p <= ntile; p++) {
+		if (ntile % p != 0 || p > nu / (2*NGHOST) || ntile / p > nv / (2*NGHOST)) {
+			continue;
+		}
+		int q = ntile / p;
+
+		number perimeter = (number)nu / p + (number)nv / q;
+		if (perimeter < best) {
+			best = perimeter;
+			*ntile_u = p;
+			*ntile_v = q;
+		}
+	}
+
+	if (best == DBL_MAX) {
+		printf("cannot tile %d x %d cells into %d tiles\n", nu, nv, ntile);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * tile t of ntile along a dimension of n cells spans [cuts[t], cuts[t+1]),
+ * starting balanced in cells
+ */
+static std::vector<int> even_cuts(int ntile, int n)
+{
+	std::vector<int> cuts(ntile + 1);
+	int nin = n - 2*NGHOST;
+
+	for (int t = 0; t <= ntile; t++) {
+		cuts[t] = NGHOST + nin * t / ntile;
+	}
+	return cuts;
+}
+
+/*
+ * Moves cuts toward equal cost of the slabs between them, given each slab's
+ * cost and taking it as uniform within the slab. To not chase noise, cuts
+ * only move if the costliest slab is over the mean by REBALANCE_TOLERANCE,
+ * and then only half way. Slabs stay 2*NGHOST wide so stencils never reach
+ * past the adjacent tiles.
+ */
+static void balance_cuts(std::vector<int> &cuts, const std::vector<number> &cost)
+{
+	const int ntile = cuts.size() - 1;
+	const int min_width = 2*NGHOST;
+	number total = 0;
+	number worst = 0;
+
+	for (int k = 0; k < ntile; k++) {
+		total += cost[k];
+		worst = fmax(worst, cost[k]);
+	}
+	if (ntile < 2 || total <= 0 || worst * ntile <= (1 + REBALANCE_TOLERANCE) * total ||
+		cuts[ntile] - cuts[0] < ntile * min_width) {
+		return;
+	}
+
+	std::vector<int> next = cuts;
+	// cost of the slabs before slab k
+	number below = 0;
+	int k = 0;
+	for (int c = 1; c < ntile; c++) {
+		number target = total * c / ntile;
+
+		while (k < ntile - 1 && below + cost[k] < target) {
+			below += cost[k];
+			k++;
+		}
+
+		number x = cuts[k];
+		if (cost[k] > 0) {
+			x += (target - below) / cost[k] * (cuts[k+1] - cuts[k]);
+		}
+		next[c] = (int)lround(cuts[c] + 0.5 * (x - cuts[c]));
+	}
+
+	for (int c = 1; c < ntile; c++) {
+		next[c] = std::max(next[c], next[c-1] + min_width);
+	}
+	for (int c = ntile - 1; c > 0; c--) {
+		next[c] = std::min(next[c], next[c+1] - min_width);
+	}
+	cuts = next;
+}
+
+/*
+ * range [l, u) of tile t between cuts, first/last tiles also own the domain
+ * edge faces and reconstruction cells
+ */
+static void tile_bounds(int t, const std::vector<int> &cuts, int *l, int *u, int *uf, int *lr, int *ur)
+{
+	int ntile = cuts.size() - 1;
+
+	*l = cuts[t];
+	*u = cuts[t+1];
+
+	if (t == 0) {
+		*lr = *l - 1;
+	} else {
+		*lr = *l;
+	}
+
+	if (t == ntile - 1) {
+		*uf = *u + 1;
+		*ur = *u + 1;
+	} else {
+		*uf = *u;
+		*ur = *u;
+	}
+}
+
+// which tiles a phase waits on, in order of strength
+enum {
+	// only the earlier phases of its own tile
+	DEP_NONE,
+	// the tiles around it whose cells and faces its stencils read
+	DEP_NEIGHBORS,
+	// every tile, for the dt reduction and rebalancing
+	DEP_ALL
+};
+
+/*
+ * One tile's share of a phase of the step. It may run once the tiles in dep
+ * have published as many phases as this tile, and if publish, it counts as a
+ * finished phase for the tiles waiting on this one. If timed, its run time
+ * counts toward the tile's load.
+ */
+class Phase {
+public:
+	int dep;
+	bool publish;
+	bool timed;
+	std::function<void()> run;
+};
+
+/*
+ * A tile of the grid and its progress through the steps as a list of phases
+ * per step, run by whichever thread claims it once the next phase is ready.
+ */
+class Tile {
 public:
 	int tid;
 	Integrator &integrator;
-	std::unique_ptr<std::thread> thread;
 	Grid &global_grid;
 	Grid local_grid;
-	ThreadBarrier *barrier;
+	EpochSync *sync;
 	Broadcaster &broadcaster;
 
-	IntegratorThread(int tid, Integrator &integrator, Grid &g, ThreadBarrier *barrier, Broadcaster &broadcaster)
+	// this tile's copy of the clock, every tile computes the same
+	// sequence so they agree without sync
+	number time = 0;
+	number dt = 0;
+	number step_time = 0;
+	number step_dt = 0;
+	number out_time = 0;
+	int split_dir;
+	int step = 0;
+
+	// phases finished, published to neighbors through sync
+	int epoch = 0;
+	// ghosts are filled at the start of the next stage
+	number boundary_time = 0;
+	// tiles around this one including diagonal and periodic wraparound,
+	// whose prim, cons and faces this one reads or they read of this one
+	std::vector<int> neighbors;
+
+	// every tile's copy of the cuts between rows and columns of tiles,
+	// moved the same way by all of them when rebalancing
+	int ntile_u;
+	int ntile_v;
+	std::vector<int> cut_u;
+	std::vector<int> cut_v;
+	// seconds of timed phases since the last rebalance, and the loads of
+	// all tiles snapshotted for it
+	number busy = 0;
+	std::vector<number> *loads;
+
+	// this step's phases and the next one to run, empty after the last step
+	std::vector<Phase> phases;
+	size_t pc = 0;
+	// claimed by a thread
+	alignas(64) std::atomic<bool> running{false};
+
+	Tile(int tid, int ntile_u, int ntile_v, Integrator &integrator, Grid &g, EpochSync *sync, Broadcaster &broadcaster, std::vector<number> *loads)
 	: tid{tid}, integrator{integrator}, global_grid{g},
-	local_grid{global_time, dt, step_time, step_dt}, broadcaster{broadcaster} {
-		this->barrier = barrier;
+	local_grid{time, dt, step_time, step_dt}, sync{sync},
+	broadcaster{broadcaster}, split_dir{integrator.split_dir},
+	ntile_u{ntile_u}, ntile_v{ntile_v},
+	cut_u{even_cuts(ntile_u, g.nu)}, cut_v{even_cuts(ntile_v, g.nv)},
+	loads{loads} {
 
-		int ni_per_thread = (global_grid.nu - 2*NGHOST + NTHREAD - 1) / NTHREAD;
+		int ti = tid / ntile_v;
+		int tj = tid % ntile_v;
 
-		local_grid.il = NGHOST + ni_per_thread * tid;
-		if (tid == 0) {
-			local_grid.ilr = local_grid.il - 1;
-		} else {
-			local_grid.ilr = local_grid.il;
-		}
+		set_bounds();
 
-		if (tid == NTHREAD - 1) {
-			local_grid.iu = global_grid.nu - NGHOST;
-			local_grid.iuf = local_grid.iu + 1;
-			local_grid.iur = local_grid.iu + 1;
-		} else {
-			local_grid.iu = NGHOST + ni_per_thread * (tid + 1);
-			local_grid.iuf = local_grid.iu;
-			local_grid.iur = local_grid.iu;
-		}
+		for (int di = -1; di <= 1; di++) {
+			for (int dj = -1; dj <= 1; dj++) {
+				int t = (ti + di + ntile_u) % ntile_u * ntile_v
+					+ (tj + dj + ntile_v) % ntile_v;
 
-		local_grid.jl = NGHOST;
-		local_grid.ju = global_grid.nv - NGHOST;
+				if (t != tid && std::find(neighbors.begin(), neighbors.end(), t) == neighbors.end()) {
+					neighbors.push_back(t);
+				}
+			}
+		}
 
 		local_grid.tid = tid;
 		local_grid.AttachReference(global_grid);
-		start();
 	}
-	~IntegratorThread() {
-		join();
+	~Tile() {
 		local_grid.DetachReference();
 	}
 
-	void start() {
-		thread = std::make_unique<std::thread>(&IntegratorThread::thread_main, this);
+	void set_bounds() {
+		tile_bounds(tid / ntile_v, cut_u, &local_grid.il, &local_grid.iu,
+			&local_grid.iuf, &local_grid.ilr, &local_grid.iur);
+		tile_bounds(tid % ntile_v, cut_v, &local_grid.jl, &local_grid.ju,
+			&local_grid.juf, &local_grid.jlr, &local_grid.jur);
 	}
-	void join() {
-		if (thread) {
-			if (thread->joinable()) {
-				thread->join();
+
+	/*
+	 * every tile moves the cuts the same way from the loads of the rows and
+	 * columns of tiles, which stay put until all tiles have read them
+	 */
+	void rebalance() {
+		std::vector<number> cost_u(ntile_u, 0);
+		std::vector<number> cost_v(ntile_v, 0);
+
+		for (int t = 0; t < ntile_u * ntile_v; t++) {
+			cost_u[t / ntile_v] += (*loads)[t];
+			cost_v[t % ntile_v] += (*loads)[t];
+		}
+		balance_cuts(cut_u, cost_u);
+		balance_cuts(cut_v, cost_v);
+		set_bounds();
+	}
+
+	/*
+	 * the part [lo, hi) of [l, u) at least NGHOST from both ends, which
+	 * needs no neighbor data, empty without OVERLAP_EDGES
+	 */
+	static void interior(int l, int u, int *lo, int *hi) {
+		if (OVERLAP_EDGES) {
+			*lo = std::min(l + NGHOST, u);
+			*hi = std::max(u - NGHOST, *lo);
+		} else {
+			*lo = l;
+			*hi = l;
+		}
+	}
+
+	/*
+	 * fused fluxes along dir for only the faces whose stencil is within this
+	 * tile's cells, or the rest
+	 */
+	void sweep(int dir, bool find_dt, bool interior_faces) {
+		int l = (dir == 0) ? local_grid.il : local_grid.jl;
+		int u = (dir == 0) ? local_grid.iu : local_grid.ju;
+		int uf = (dir == 0) ? local_grid.iuf : local_grid.juf;
+		int lo, hi;
+
+		// face k reads cells within NGHOST of it, tiles own faces [l, uf)
+		interior(l, u + 1, &lo, &hi);
+		lo = std::min(lo, uf);
+		hi = std::min(hi, uf);
+		if (interior_faces) {
+			if (lo < hi) {
+				local_grid.Sweep(dir, find_dt, lo, hi);
+			}
+		} else {
+			if (l < lo) {
+				local_grid.Sweep(dir, find_dt, l, lo);
+			}
+			if (hi < uf) {
+				local_grid.Sweep(dir, find_dt, hi, uf);
 			}
-			thread.reset();
 		}
 	}
 
-	void take_timestep() {
-		Array<number> *J;
-		int &s = integrator.s;
-		if (tid == 0) {
-			s = 0;
-			global_grid.cons_gen.copy_data_from(global_grid.cons);
-			dt = DBL_MAX;
+	void sweeps(int dir, bool find_dt, bool interior_faces) {
+		for (int d = 0; d < 2; d++) {
+			if (dir == 2 || dir == d) {
+				sweep(d, find_dt, interior_faces);
+			}
 		}
-		barrier->wait();
+	}
 
-		while (s < integrator.nstep) {
-			for (int dir = 0; dir < 2; dir++) {
-				if (dir == 0) {
-					J = &local_grid.Ju;
-				} else {
-					J = &local_grid.Jv;
-				}
+	// unfused fluxes phase by phase, PrimLim and PrimToCons go by rows
+	// over the whole grid so they and the next phase wait on every tile
+	void limit(int dir) {
+		local_grid.PrimLim(local_grid.Lprim);
+		local_grid.PrimLim(local_grid.Rprim);
+		if (local_grid.riemann_solver == SOLVER_HLLC) {
+			local_grid.PrimToCons(local_grid.Lprim, local_grid.Lcons);
+			local_grid.PrimToCons(local_grid.Rprim, local_grid.Rcons);
+		} else {
+			local_grid.PrimToConsFlux(dir, local_grid.Lprim, local_grid.Lcons, local_grid.LJ);
+			local_grid.PrimToConsFlux(dir, local_grid.Rprim, local_grid.Rcons, local_grid.RJ);
+		}
+	}
+
+	void flux(int dir, bool find_dt) {
+		Array<number> &J = (dir == 0) ? local_grid.Ju : local_grid.Jv;
+
+		local_grid.Wavespeed(dir, find_dt);
 
-				local_grid.Reconstruct(dir);
-				barrier->wait();
+		if (local_grid.riemann_solver == SOLVER_HLLC) {
+			riemann::HLLC(local_grid.Lprim, local_grid.Lcons,
+			local_grid.Lw, local_grid.Rprim, local_grid.Rcons, local_grid.Rw, J, dir,
+			local_grid.il, (dir == 0) ? local_grid.iuf : local_grid.iu,
+			local_grid.jl, (dir == 0) ? local_grid.ju : local_grid.juf);
+		} else {
+			riemann::HLLE(local_grid.Lcons, local_grid.LJ,
+			local_grid.Lw, local_grid.Rcons, local_grid.RJ, local_grid.Rw, J, dir,
+			local_grid.il, (dir == 0) ? local_grid.iuf : local_grid.iu,
+			local_grid.jl, (dir == 0) ? local_grid.ju : local_grid.juf);
+		}
+	}
 
-				local_grid.PrimLim(local_grid.Lprim);
-				local_grid.PrimLim(local_grid.Rprim);
-				local_grid.PrimToCons(local_grid.Lprim, local_grid.Lcons);
-				local_grid.PrimToCons(local_grid.Rprim, local_grid.Rcons);
-				barrier->wait();
+	// ghosts next to this tile's cells from the last stage
+	void fill_ghosts() {
+		local_grid.Boundary(boundary_time);
+		local_grid.ConsLimGhost();
+	}
 
-				local_grid.Wavespeed(dir);
+	// stage s of cells [il, iu) x [jl, ju)
+	void update(int s, int dir, int il, int iu, int jl, int ju) {
+		if (il < iu && jl < ju) {
+			integrator.AddFluxDivSrc(&local_grid, s, dir, il, iu, jl, ju);
+			local_grid.ConsLim(il, iu, jl, ju);
+		}
+	}
 
-				// timestep determination
-				barrier->wait();
-				if (tid == 0 && s == 0) {
-					global_grid.DetermineDt(dir);
-				}
-				barrier->wait();
+	void update_interior(int s, int dir, bool find_dt) {
+		int ilo, ihi, jlo, jhi;
 
-				riemann::HLLC(local_grid.Lprim, local_grid.Lcons,
-				local_grid.Lw, local_grid.Rprim, local_grid.Rcons, local_grid.Rw, *J, dir,
-				local_grid.il, local_grid.iuf, local_grid.jl, local_grid.ju);
-			}
+		// finalize timestep determination
+		if (find_dt) {
+			local_grid.CombineDt();
+			dt *= integrator.cfl_num;
+		}
+		step_dt = integrator.time_weight(s) * dt;
+		if (s == 0) {
+			step_time = time;
+		} else {
+			step_time = time + integrator.time_weight(s-1) * dt;
+		}
 
-			// finalize timestep determination
+		// hydro
+		local_grid.CalculateSrc();
+		if (s == 0) {
+			// cons_gen keeps the step's initial state
+			local_grid.RotateState();
 			if (tid == 0) {
-				if (s == 0) {
-					dt *= integrator.cfl_num;
+				global_grid.RotateState();
+			}
+		}
+
+		interior(local_grid.il, local_grid.iu, &ilo, &ihi);
+		interior(local_grid.jl, local_grid.ju, &jlo, &jhi);
+		update(s, dir, ilo, ihi, jlo, jhi);
+	}
+
+	void update_edges(int s, int dir) {
+		const int il = local_grid.il;
+		const int iu = local_grid.iu;
+		const int jl = local_grid.jl;
+		const int ju = local_grid.ju;
+		int ilo, ihi, jlo, jhi;
+
+		interior(il, iu, &ilo, &ihi);
+		interior(jl, ju, &jlo, &jhi);
+		update(s, dir, il, ilo, jl, ju);
+		update(s, dir, ihi, iu, jl, ju);
+		update(s, dir, ilo, ihi, jl, jlo);
+		update(s, dir, ilo, ihi, jhi, ju);
+
+		// fills and converts the ghosts next to its cells at the start
+		// of the next stage
+		boundary_time = step_time;
+	}
+
+	void add(int dep, bool publish, std::function<void()> run, bool timed = true) {
+		phases.push_back(Phase{dep, publish, timed, std::move(run)});
+	}
+
+	/*
+	 * all rk stages over dt with fluxes along dir only for a split substep,
+	 * or along both if dir is 2, in which case dt is also found in stage 0.
+	 *
+	 * Only the dt reduction waits on every tile, otherwise phases wait on
+	 * the neighbors reading or writing the same cells and faces. With
+	 * OVERLAP_EDGES, the faces and cells that need no neighbor data are done
+	 * in phases of their own that need not wait.
+	 */
+	void add_stages(int dir) {
+		for (int s = 0; s < integrator.nstep; s++) {
+			const bool find_dt = (dir == 2 && s == 0);
+
+			if (FUSED_SWEEP) {
+				add(DEP_NONE, false, [=] { sweeps(dir, find_dt, true); });
+				add(DEP_NEIGHBORS, true, [=] {
+					fill_ghosts();
+					sweeps(dir, find_dt, false);
+				});
+			} else {
+				for (int d = 0; d < 2; d++) {
+					if (dir != 2 && dir != d) {
+						continue;
+					}
+
+					const bool first = (dir != 2 || d == 0);
+					add(DEP_NEIGHBORS, true, [=] {
+						if (first) {
+							fill_ghosts();
+						}
+						local_grid.Reconstruct(d);
+					});
+					add(DEP_ALL, true, [=] { limit(d); });
+					add(DEP_ALL, true, [=] { flux(d, find_dt); });
+				}
+			}
+
+			add(find_dt ? DEP_ALL : DEP_NONE, false, [=] { update_interior(s, dir, find_dt); });
+			add(DEP_NEIGHBORS, true, [=] { update_edges(s, dir); });
+		}
+	}
+
+	// phases of the next step, none after the last
+	void plan_step() {
+		phases.clear();
+		pc = 0;
+		if (step == integrator.max_epoch) {
+			return;
+		}
+
+		if (tid == 0) {
+			printf("t = %.3e\tdt = %.3e\t%.2f%%\n", time, dt, 100*time/integrator.out_tf);
+		}
+
+		// tiles move only between steps, and cells change hands only
+		// after every tile has finished with them
+		if (REBALANCE_STEPS > 0 && step > 0 && step % REBALANCE_STEPS == 0) {
+			add(DEP_ALL, true, [this] {
+				(*loads)[tid] = busy;
+				busy = 0;
+			}, false);
+			add(DEP_ALL, true, [this] { rebalance(); }, false);
+		}
+
+		if (time >= out_time) {
+			// only this tile's own cells are read, the rest of the frame
+			// is converted and sent off the solver threads
+			add(DEP_NONE, false, [this] {
+				broadcaster.snapshot(local_grid);
+				out_time = time + integrator.out_dt;
+			}, false);
+		}
+
+		// per-tile minimum crossing time is found with the wavespeeds
+		local_grid.dt_slot = 1 - local_grid.dt_slot;
+		local_grid.dt_tile(local_grid.dt_slot, tid) = DBL_MAX;
+
+		if (integrator.strang_split) {
+			// 1D cfl from cell centers as dt is fixed before the substeps
+			add(DEP_NONE, true, [this] { local_grid.CellDt(); });
+			add(DEP_ALL, false, [this] {
+				local_grid.CombineDt();
+				dt *= integrator.cfl_num;
+			});
+
+			// direction order alternates every step
+			add_stages(split_dir);
+			add_stages(1 - split_dir);
+		} else {
+			add_stages(2);
+		}
+	}
+
+	void end_step() {
+		time += dt;
+		if (tid == 0) {
+			global_time = time;
+			::dt = dt;
+		}
+		if (integrator.strang_split) {
+			split_dir = 1 - split_dir;
+		}
+		step++;
+		plan_step();
+	}
+
+	// whether the tiles the next phase depends on have caught up
+	bool ready() {
+		switch (phases[pc].dep) {
+		case DEP_NEIGHBORS:
+			for (int t : neighbors) {
+				if (!sync->reached(t, epoch)) {
+					return false;
 				}
-				step_dt = integrator.time_weight(s) * dt;
-				if (s == 0) {
-					step_time = global_time;
-				} else {
-					step_time = global_time + integrator.time_weight(s-1) * dt;
+			}
+			break;
+		case DEP_ALL:
+			for (int t = 0; t < (int)sync->gates.size(); t++) {
+				if (t != tid && !sync->reached(t, epoch)) {
+					return false;
 				}
 			}
-			barrier->wait();
+			break;
+		}
+		return true;
+	}
 
-			// hydro
-			local_grid.CalculateFluxDiv();
-			local_grid.CalculateSrc();
+	/*
+	 * run phases as long as they are ready unless another thread has
+	 * claimed this tile, whether any ran and if the last step just ended
+	 */
+	bool try_run(bool *finished) {
+		bool ran = false;
 
-			integrator.AddFluxDivSrc(&local_grid);
-			barrier->wait();
+		if (running.load(std::memory_order_relaxed) ||
+			running.exchange(true, std::memory_order_acquire)) {
+			return false;
+		}
 
-			local_grid.ConsLim();
-			local_grid.ConsToPrim();
+		while (pc < phases.size() && ready()) {
+			Phase &phase = phases[pc];
+			auto start = std::chrono::steady_clock::now();
 
-			barrier->wait();
-			if (tid == 0) {
-				global_grid.Boundary(step_time);
+			phase.run();
+			if (phase.timed) {
+				busy += std::chrono::duration<number>(std::chrono::steady_clock::now() - start).count();
 			}
-			barrier->wait();
+			if (phase.publish) {
+				epoch++;
+				sync->publish(tid);
+			}
+			ran = true;
 
-			local_grid.ConsLim();
-			local_grid.ConsToPrim();
+			pc++;
+			if (pc == phases.size()) {
+				end_step();
+				*finished = phases.empty();
+			}
+		}
 
-			if (tid == 0) {
-				s++;
+		running.store(false, std::memory_order_release);
+		return ran;
+	}
+};
+
+/*
+ * Worker thread running ready phases of the tiles, first of its home tiles
+ * and otherwise stolen from the other threads' tiles, sleeping when none are
+ * ready until some tile publishes.
+ */
+class IntegratorThread {
+public:
+	int tid;
+	int nthread;
+	std::unique_ptr<std::thread> thread;
+	Grid &global_grid;
+	std::vector<std::unique_ptr<Tile>> &tiles;
+	ThreadBarrier *barrier;
+	EpochSync *sync;
+	std::atomic<int> *nfinished;
+	// core to pin to, -1 to let the scheduler migrate the thread
+	int cpu;
+
+	IntegratorThread(int tid, int nthread, Grid &g, std::vector<std::unique_ptr<Tile>> &tiles, ThreadBarrier *barrier, EpochSync *sync, std::atomic<int> *nfinished, int cpu)
+	: tid{tid}, nthread{nthread}, global_grid{g}, tiles{tiles},
+	barrier{barrier}, sync{sync}, nfinished{nfinished}, cpu{cpu} {
+		start();
+	}
+	~IntegratorThread() {
+		join();
+	}
+
+	void start() {
+		thread = std::make_unique<std::thread>(&IntegratorThread::thread_main, this);
+	}
+	void join() {
+		if (thread) {
+			if (thread->joinable()) {
+				thread->join();
+			}
+			thread.reset();
+		}
+	}
+
+	// home tiles [*l, *u) of thread t
+	void home_tiles(int t, int *l, int *u) {
+		*l = (int)tiles.size() * t / nthread;
+		*u = (int)tiles.size() * (t + 1) / nthread;
+	}
+
+	bool run_tiles(int t) {
+		bool ran = false;
+		int l, u;
+
+		home_tiles(t, &l, &u);
+		for (int k = l; k < u; k++) {
+			bool finished = false;
+
+			ran |= tiles[k]->try_run(&finished);
+			if (finished) {
+				nfinished->fetch_add(1);
+				// wake sleeping threads to notice
+				sync->any.open();
 			}
-			barrier->wait();
 		}
+		return ran;
+	}
 
+	/*
+	 * scratch and home tiles' pages of the shared arrays are first touched
+	 * here after pinning so they land on this thread's numa node, then the
+	 * state is set as at the end of a stage
+	 */
+	void init_state() {
+		int l, u;
+
+		home_tiles(tid, &l, &u);
+		for (int k = l; k < u; k++) {
+			tiles[k]->local_grid.AllocScratch();
+			tiles[k]->local_grid.FirstTouch();
+		}
+		barrier->wait();
+
+		// user initial conditions are written for the whole grid
 		if (tid == 0) {
-			global_time += dt;
+			global_grid.InitCond();
+		}
+		barrier->wait();
+
+		for (int k = l; k < u; k++) {
+			tiles[k]->local_grid.ConsLim();
+			tiles[k]->boundary_time = tiles[k]->time;
+			tiles[k]->plan_step();
 		}
 		barrier->wait();
 	}
 
 	void thread_main() {
-		for (int epoch = 0; epoch < integrator.max_epoch; epoch++) {
-			if (tid == 0) {
-				printf("t = %.3e\tdt = %.3e\t%.2f%%\n", global_time, dt, 100*global_time/integrator.out_tf);
-				if (global_time >= out_time) {
-					broadcaster.broadcast();
-					out_time = global_time + integrator.out_dt;
-				}
+		if (cpu >= 0) {
+			confine_to_cpus({cpu});
+		}
+
+		init_state();
+
+		for (;;) {
+			int seen = sync->any.current();
+			if (nfinished->load() == (int)tiles.size()) {
+				break;
 			}
 
-			take_timestep();
+			bool ran = run_tiles(tid);
+
+			for (int k = 1; !ran && k < nthread; k++) {
+				ran = run_tiles((tid + k) % nthread);
+			}
+			if (!ran) {
+				sync->any.wait(seen);
+			}
 		}
 	}
 };
 
-int main()
+/*
+ * largest difference of density between cells that mirror each other across
+ * either axis or the diagonal, 0 for an exactly symmetric state
+ */
+static number asymmetry(const Grid &g)
+{
+	const int nu = g.nu - 2*NGHOST;
+	const int nv = g.nv - 2*NGHOST;
+	number worst = 0;
+
+	for (int i = 0; i < nu; i++) {
+		for (int j = 0; j < nv; j++) {
+			number rho = g.cons(0, i+NGHOST, j+NGHOST);
+
+			worst = fmax(worst, fabs(rho - g.cons(0, nu-1-i+NGHOST, j+NGHOST)));
+			worst = fmax(worst, fabs(rho - g.cons(0, i+NGHOST, nv-1-j+NGHOST)));
+			if (nu == nv) {
+				worst = fmax(worst, fabs(rho - g.cons(0, j+NGHOST, i+NGHOST)));
+			}
+		}
+	}
+	return worst;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [-n nthread] [-c cpu_list] [-b cpu_list] [-s nstep]\n"
+		"  -n  number of integrator threads (env FLUID_NTHREAD, default %d)\n"
+		"  -c  pin integrator thread tid to the tid-th core of a list like 0-3,8,\n"
+		"      with at least nthread cores (env FLUID_CPUS, default unpinned)\n"
+		"  -b  confine the broadcast server and converter threads to these cores\n"
+		"      (env FLUID_BROADCAST_CPUS, default unconfined)\n"
+		"  -s  stop after nstep steps and fail unless the density is exactly\n"
+		"      mirror and transpose symmetric, for symmetric problems\n",
+		name, NTHREAD);
+}
+
+int main(int argc, char **argv)
 {
+	std::vector<std::unique_ptr<Tile>> tiles;
 	std::vector<std::unique_ptr<IntegratorThread>> integrator_threads;
-	ThreadBarrier barrier{NTHREAD};
+
+	// options override environment
+	int nthread = NTHREAD;
+	const char *nthread_str = getenv("FLUID_NTHREAD");
+	const char *cpu_str = getenv("FLUID_CPUS");
+	const char *broadcast_cpu_str = getenv("FLUID_BROADCAST_CPUS");
+	int check_nstep = 0;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:c:b:s:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			nthread_str = optarg;
+			break;
+		case 'c':
+			cpu_str = optarg;
+			break;
+		case 'b':
+			broadcast_cpu_str = optarg;
+			break;
+		case 's':
+			check_nstep = atoi(optarg);
+			if (check_nstep < 1) {
+				printf("bad number of steps \"%s\"\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		default:
+			usage(argv[0]);
+			exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+	if (nthread_str != NULL) {
+		nthread = atoi(nthread_str);
+		if (nthread < 1) {
+			printf("bad number of threads \"%s\"\n", nthread_str);
+			exit(EXIT_FAILURE);
+		}
+	}
+	std::vector<int> cpus = parse_cpu_list(cpu_str);
+	// one core per thread, pinned threads sharing a core spin against each other
+	if (!cpus.empty() && (int)cpus.size() < nthread) {
+		printf("need at least %d cores in the cpu list \"%s\", got %zu\n",
+			nthread, cpu_str, cpus.size());
+		exit(EXIT_FAILURE);
+	}
+	std::vector<int> broadcast_cpus = parse_cpu_list(broadcast_cpu_str);
+
+	int ntile = nthread * TILES_PER_THREAD;
+	ThreadBarrier barrier{nthread};
+	EpochSync sync{ntile};
+	std::atomic<int> nfinished{0};
+	std::vector<number> loads(ntile, 0);
 
 	Grid global_grid{global_time, dt, step_time, step_dt};
 	global_grid.tid = -1;
+	global_grid.ntile = ntile;
 	global_grid.InitGrid();
 
 	Integrator integrator;
 	integrator.Property();
+	if (check_nstep > 0) {
+		integrator.max_epoch = check_nstep;
+	}
+	printf("nstep = %d\tcfl_num = %.3f\trecommended cfl_num = %.3f\n",
+		integrator.nstep, integrator.cfl_num, integrator.RecommendedCfl());
 
-	Broadcaster broadcaster{global_grid, 9743, 2, 0, 24};
+	Broadcaster broadcaster{global_grid, 9743, 2, 0, 24, broadcast_cpus};
+
+	int ntile_u, ntile_v;
+	choose_tiles(ntile, global_grid.nu - 2*NGHOST, global_grid.nv - 2*NGHOST, &ntile_u, &ntile_v);
+	for (int tid = 0; tid < ntile; tid++) {
+		tiles.push_back(std::make_unique<Tile>(tid, ntile_u, ntile_v, integrator, global_grid, &sync, broadcaster, &loads));
+	}
 
-	for (int tid = 0; tid < NTHREAD; tid++) {
-		integrator_threads.push_back(std::make_unique<IntegratorThread>(tid, integrator, global_grid, &barrier, broadcaster));
+	for (int tid = 0; tid < nthread; tid++) {
+		int cpu = cpus.empty() ? -1 : cpus[tid];
+		integrator_threads.push_back(std::make_unique<IntegratorThread>(tid, nthread, global_grid, tiles, &barrier, &sync, &nfinished, cpu));
 	}
 
-	for (int tid = 0; tid < NTHREAD; tid++) {
+	for (int tid = 0; tid < nthread; tid++) {
 		integrator_threads[tid]->join();
 	}
 
+	if (check_nstep > 0) {
+		number error = asymmetry(global_grid);
+
+		printf("asymmetry after %d steps = %.3e\n", check_nstep, error);
+		return (error == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	return 0;
 }
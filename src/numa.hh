@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2023 Bryance Oyang
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif /* __linux__ */
+
+/*
+ * spread the pages of [data, data + bytes) round robin over the nodes this
+ * process may allocate on, must be called before the pages are touched,
+ * no-op off linux or on failure (eg. single node kernels without numa)
+ */
+static inline void numa_interleave(void *data, size_t bytes)
+{
+#ifdef __linux__
+	// enough for 1024 nodes
+	const unsigned long maxnode = 1024;
+	unsigned long nodemask[maxnode / (8*sizeof(unsigned long))] = {0};
+
+	if (data == NULL || bytes == 0) {
+		return;
+	}
+
+	if (syscall(SYS_get_mempolicy, NULL, nodemask, maxnode, NULL, MPOL_F_MEMS_ALLOWED) != 0) {
+		return;
+	}
+
+	// mbind wants a page aligned start
+	const uintptr_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t)data & ~(page - 1);
+	uintptr_t end = (uintptr_t)data + bytes;
+
+	if (syscall(SYS_mbind, (void *)start, end - start, MPOL_INTERLEAVE, nodemask, maxnode, 0) != 0) {
+		static bool warned = false;
+		if (!warned) {
+			warned = true;
+			printf("warning: could not interleave grid memory\n");
+		}
+	}
+#else
+	(void)data;
+	(void)bytes;
+#endif /* __linux__ */
+}
+
+#endif /* NUMA_H */
@@ -12,6 +12,10 @@
 #include "util.hh"
 #include "grid.hh"
 
+#if SIMD_PPM
+#include "simd.hh"
+#endif /* SIMD_PPM */
+
 static inline number vl_lim(number r)
 {
 	number fabsr;
@@ -144,43 +148,189 @@ static inline void fancy_ppm(number *pql, number *pqr, number q0, number q1, num
 	}
 }
 
+#if SIMD_PPM
+// ppm_lim_parabola on all lanes with every branch evaluated and blended
+static inline void ppm_lim_parabola_simd(vnumber &ql, vnumber &qr, const vnumber &q0,
+	const vnumber &q1, const vnumber &q2, const vnumber &q3, const vnumber &q4)
+{
+	vnumber curvl, curvr, curvc, curvf, curv;
+	vnumber nql, nqr;
+	vmask extrema, same_sign, flat, peak_l, peak_r;
+	number D;
+
+	D = 1.26;
+	if (PPM_STRICT_LIM) {
+		D = 1;
+	}
+
+	// at local extrema
+	extrema = ((qr - q2) * (q2 - ql) <= 0) || ((q3 - q2) * (q2 - q1) <= 0);
+	curvc = (q1 + q3) - 2*q2;
+	curvl = (q0 + q2) - 2*q1;
+	curvr = (q2 + q4) - 2*q3;
+	if (WEIRD_PPM) {
+		curvf = 4*((ql + qr) - 2*q2);
+	} else {
+		curvf = 6*((ql + qr) - 2*q2);
+	}
+	same_sign = (vsign(curvl) == vsign(curvc)) && (vsign(curvc) == vsign(curvr))
+		&& (vsign(curvc) == vsign(curvf));
+	curv = vsign(curvf) * util::fmin4(D*fabs(curvl), D*fabs(curvc), D*fabs(curvr), fabs(curvf));
+	where(!same_sign, curv) = 0;
+
+	// choose smoothly between q2 and ql/qr
+	flat = curvf == 0;
+	nql = q2 + (ql - q2) * curv / curvf;
+	nqr = q2 + (qr - q2) * curv / curvf;
+	where(flat, nql) = q2;
+	where(flat, nqr) = q2;
+
+	// move parabola peak out of cell
+	peak_l = !extrema && (fabs(ql - q2) >= 2*fabs(qr - q2));
+	peak_r = !extrema && !peak_l && (fabs(qr - q2) >= 2*fabs(ql - q2));
+
+	vnumber ql_peak = q2 - 2*(qr - q2);
+	vnumber qr_peak = q2 - 2*(ql - q2);
+	where(extrema, ql) = nql;
+	where(extrema, qr) = nqr;
+	where(peak_l, ql) = ql_peak;
+	where(peak_r, qr) = qr_peak;
+}
+
+// one side of fancy_ppm: interface value between qa|qb with outer neighbors
+static inline vnumber ppm_face_simd(const vnumber &qo_l, const vnumber &qa,
+	const vnumber &qb, const vnumber &qo_r)
+{
+	vnumber q, curvl, curvr, curvf, curv;
+	vmask lim, same_sign;
+	number C;
+
+	C = 1.26;
+	if (PPM_STRICT_LIM) {
+		C = 1;
+	}
+
+	q = (7.0*(qa + qb) - (qo_l + qo_r)) / 12;
+	curvl = (qo_l + qb) - 2*qa;
+	curvr = (qa + qo_r) - 2*qb;
+	curvf = 3*((qa + qb) - 2*q);
+
+	// if not monotonic
+	lim = (curvr - curvf) * (curvl - curvf) > 0;
+	if (PPM_ALWAYS_LIM) {
+		lim = vmask{true};
+	}
+	same_sign = (vsign(curvl) == vsign(curvf)) && (vsign(curvf) == vsign(curvr));
+	curv = vsign(curvf) * util::fmin3(C*fabs(curvl), C*fabs(curvr), fabs(curvf));
+	where(!same_sign, curv) = 0;
+
+	where(lim, q) = 0.5 * (qa + qb) - curv / 6;
+	return q;
+}
+
+static inline void fancy_ppm_simd(vnumber &ql, vnumber &qr, const vnumber &q0,
+	const vnumber &q1, const vnumber &q2, const vnumber &q3, const vnumber &q4)
+{
+	ql = ppm_face_simd(q0, q1, q2, q3);
+	qr = ppm_face_simd(q1, q2, q3, q4);
+
+	ppm_lim_parabola_simd(ql, qr, q0, q1, q2, q3, q4);
+
+	if (PPM_STRICT_LIM) {
+		ql = fmin(fmax(q1,q2),ql);
+		ql = fmax(fmin(q1,q2),ql);
+
+		qr = fmin(fmax(q3,q2),qr);
+		qr = fmax(fmin(q3,q2),qr);
+	}
+}
+#endif /* SIMD_PPM */
+
 void Grid::Reconstruct(int dir)
 {
-	int di, dj;
+	typedef void (Grid::*RowKernel)(const number *, int, number *, number *, int, int);
+	static const RowKernel row_kernels[3] = {
+		&Grid::ReconstructRow<1>,
+		&Grid::ReconstructRow<2>,
+		&Grid::ReconstructRow<3>,
+	};
+	const RowKernel reconstruct_row = row_kernels[reconstruct_order-1];
+
+	// cells feeding this tile's faces along dir
+	int di, dj, stride;
+	int iil, iiu, jjl, jju;
 	if (dir == 0) {
 		di = 1;
 		dj = 0;
+		stride = prim.n[2];
+		iil = ilr;
+		iiu = iur;
+		jjl = jl;
+		jju = ju;
 	} else {
 		di = 0;
 		dj = 1;
+		stride = 1;
+		iil = il;
+		iiu = iu;
+		jjl = jlr;
+		jju = jur;
 	}
 
 	for (int m = 0; m < NQUANT; m++) {
-		for (int i = ilr; i < iur; i++) {
+		for (int i = iil; i < iiu; i++) {
 			// cell loop
-			for (int j = jl-1; j < ju+1; j++) {
-				number ql, qr;
-				number q0 = prim(m,i-2*di,j-2*dj);
-				number q1 = prim(m,i-di,j-dj);
-				number q2 = prim(m,i,j);
-				number q3 = prim(m,i+di,j+dj);
-				number q4 = prim(m,i+2*di,j+2*dj);
-
-				if (reconstruct_order == 1) {
-					ql = q2;
-					qr = q2;
-				} else if (reconstruct_order == 2) {
-					plm(&ql, &qr, q1, q2, q3);
-				} else if (reconstruct_order == 3) {
-					fancy_ppm(&ql, &qr, q0, q1, q2, q3, q4);
-				} else {
-					ql = 0;
-					qr = 0;
-				}
-
-				Rprim(m,i,j) = ql;
-				Lprim(m,i+di,j+dj) = qr;
-			}
+			(this->*reconstruct_row)(&prim(m,i,0), stride,
+				&Rprim(m,i,0), &Lprim(m,i+di,dj), jjl, jju);
 		}
 	}
 }
+
+/*
+ * reconstruct cells k in [kl, ku) of q whose stencil neighbors are stride
+ * apart: left face value to ql[k] and right face value to qr[k]
+ */
+template<int order>
+void Grid::ReconstructRow(const number *q, int stride, number *ql, number *qr, int kl, int ku)
+{
+	int k = kl;
+
+#if SIMD_PPM
+	if (order == 3) {
+		for (; k + (int)vnumber::size() <= ku; k += vnumber::size()) {
+			vnumber vql, vqr;
+			vnumber q0{&q[k - 2*stride], stdx::element_aligned};
+			vnumber q1{&q[k - stride], stdx::element_aligned};
+			vnumber q2{&q[k], stdx::element_aligned};
+			vnumber q3{&q[k + stride], stdx::element_aligned};
+			vnumber q4{&q[k + 2*stride], stdx::element_aligned};
+
+			fancy_ppm_simd(vql, vqr, q0, q1, q2, q3, q4);
+
+			vql.copy_to(&ql[k], stdx::element_aligned);
+			vqr.copy_to(&qr[k], stdx::element_aligned);
+		}
+	}
+#endif /* SIMD_PPM */
+
+	for (; k < ku; k++) {
+		number q0 = q[k - 2*stride];
+		number q1 = q[k - stride];
+		number q2 = q[k];
+		number q3 = q[k + stride];
+		number q4 = q[k + 2*stride];
+
+		if (order == 1) {
+			ql[k] = q2;
+			qr[k] = q2;
+		} else if (order == 2) {
+			plm(&ql[k], &qr[k], q1, q2, q3);
+		} else {
+			fancy_ppm(&ql[k], &qr[k], q0, q1, q2, q3, q4);
+		}
+	}
+}
+
+template void Grid::ReconstructRow<1>(const number *, int, number *, number *, int, int);
+template void Grid::ReconstructRow<2>(const number *, int, number *, number *, int, int);
+template void Grid::ReconstructRow<3>(const number *, int, number *, number *, int, int);
@@ -9,158 +9,303 @@
 #include "riemann.hh"
 #include "macro.hh"
 
+#if SIMD_HLLC
+#include "simd.hh"
+#endif /* SIMD_HLLC */
+
 namespace riemann {
 
 void HLLC(const Array<number> &Lprim, const Array<number> &Lcons, const Array<number> &Lw_array,
 	const Array<number> &Rprim, const Array<number> &Rcons, const Array<number> &Rw_array,
-	Array<number> &J, int dir, int il, int iuf, int jl, int ju)
+	Array<number> &J, int dir, int il, int iu, int jl, int ju)
 {
-	for (int i = il; i < iuf; i++) {
-		//face loop
-		for (int j = jl; j < ju+1; j++) {
-			int m;
-			number Lw, Rw, Mw;
-			number Lv, Rv;
-			number Lpress, Rpress, Mpress;
-			number Lrho, Rrho, rho2, rho3;
-			number Le, Re, e2, e3;
-
-			Lw = Lw_array(i,j);
-			Rw = Rw_array(i,j);
-
-			if (Lw == 0 && Rw == 0) {
-				for (m = 0; m < NQUANT; m++) {
-					J(m,i,j) = 0;
-				}
-				continue;
-			}
+	for (int i = il; i < iu; i++) {
+		if (dir == 0) {
+			HLLCRow<0>(&Lprim(0,i,0), &Lcons(0,i,0), &Lw_array(i,0),
+				&Rprim(0,i,0), &Rcons(0,i,0), &Rw_array(i,0), Lprim.n[1]*Lprim.n[2],
+				&J(0,i,0), J.n[1]*J.n[2], jl, ju);
+		} else {
+			HLLCRow<1>(&Lprim(0,i,0), &Lcons(0,i,0), &Lw_array(i,0),
+				&Rprim(0,i,0), &Rcons(0,i,0), &Rw_array(i,0), Lprim.n[1]*Lprim.n[2],
+				&J(0,i,0), J.n[1]*J.n[2], jl, ju);
+		}
+	}
+}
 
-			Lrho = Lprim(0,i,j);
-			Rrho = Rprim(0,i,j);
-			Lv = Lprim(1+dir,i,j);
-			Rv = Rprim(1+dir,i,j);
-			Lpress = Lprim(3,i,j);
-			Rpress = Rprim(3,i,j);
-			Le = Lcons(3,i,j);
-			Re = Rcons(3,i,j);
-
-			// supersonic
-			if (Rw < 0) {
-				for (m = 0; m < NQUANT; m++) {
-					J(m,i,j) = Rcons(m,i,j) * Rv;
-					if (m == 1+dir) {
-						J(m,i,j) += Rpress;
-					}
-					if (m == 3) {
-						J(m,i,j) += Rpress * Rv;
-					}
-				}
-				continue;
+// single face k
+template<int dir>
+static inline void hllc_face(const number *Lprim, const number *Lcons, const number *Lw_array,
+	const number *Rprim, const number *Rcons, const number *Rw_array, int stride,
+	number *J, int Jstride, int k)
+{
+	int m;
+	number Lw, Rw, Mw;
+	number Lv, Rv;
+	number Lpress, Rpress, Mpress;
+	number Lrho, Rrho, rho2, rho3;
+	number Le, Re, e2, e3;
+
+	Lw = Lw_array[k];
+	Rw = Rw_array[k];
+
+	if (Lw == 0 && Rw == 0) {
+		for (m = 0; m < NQUANT; m++) {
+			J[m*Jstride + k] = 0;
+		}
+		return;
+	}
+
+	Lrho = Lprim[k];
+	Rrho = Rprim[k];
+	Lv = Lprim[(1+dir)*stride + k];
+	Rv = Rprim[(1+dir)*stride + k];
+	Lpress = Lprim[3*stride + k];
+	Rpress = Rprim[3*stride + k];
+	Le = Lcons[3*stride + k];
+	Re = Rcons[3*stride + k];
+
+	// supersonic
+	if (Rw < 0) {
+		for (m = 0; m < NQUANT; m++) {
+			J[m*Jstride + k] = Rcons[m*stride + k] * Rv;
+			if (m == 1+dir) {
+				J[m*Jstride + k] += Rpress;
 			}
-			if (Lw > 0) {
-				for (m = 0; m < NQUANT; m++) {
-					J(m,i,j) = Lcons(m,i,j) * Lv;
-					if (m == 1+dir) {
-						J(m,i,j) += Lpress;
-					}
-					if (m == 3) {
-						J(m,i,j) += Lpress * Lv;
-					}
-				}
-				continue;
+			if (m == 3) {
+				J[m*Jstride + k] += Rpress * Rv;
 			}
-
-			// middle wave and intermediate left/right density
-			Mw = ((Rrho*Rv*(Rv-Rw) + Rpress) - (Lrho*Lv*(Lv-Lw) + Lpress)) / (Rrho*(Rv-Rw) - Lrho*(Lv-Lw));
-			rho2 = Lrho * (Lv - Lw) / (Mw - Lw);
-			rho3 = Rrho * (Rv - Rw) / (Mw - Rw);
-
-			if (Mw > 0) {
-				Mpress = Lrho*SQR(Lv) + Lpress - Lw*Lrho*Lv - rho2*SQR(Mw) + Lw*rho2*Mw;
-			} else if (Mw < 0) {
-				Mpress = Rrho*SQR(Rv) + Rpress - Rw*Rrho*Rv - rho3*SQR(Mw) + Rw*rho3*Mw;
-			} else {
-				Mpress = 0.5 * ((Lrho*SQR(Lv) + Lpress - Lw*Lrho*Lv - rho2*SQR(Mw) + Lw*rho2*Mw)
-						+ (Rrho*SQR(Rv) + Rpress - Rw*Rrho*Rv - rho3*SQR(Mw) + Rw*rho3*Mw));
+		}
+		return;
+	}
+	if (Lw > 0) {
+		for (m = 0; m < NQUANT; m++) {
+			J[m*Jstride + k] = Lcons[m*stride + k] * Lv;
+			if (m == 1+dir) {
+				J[m*Jstride + k] += Lpress;
 			}
-
-			// contact wave in middle
-			if (Mw == 0) {
-				for (m = 0; m < NQUANT; m++) {
-					J(m,i,j) = 0;
-					if (m == 1+dir) {
-						J(m,i,j) += Mpress;
-					}
-				}
-				continue;
+			if (m == 3) {
+				J[m*Jstride + k] += Lpress * Lv;
 			}
+		}
+		return;
+	}
+
+	// middle wave and intermediate left/right density
+	Mw = ((Rrho*Rv*(Rv-Rw) + Rpress) - (Lrho*Lv*(Lv-Lw) + Lpress)) / (Rrho*(Rv-Rw) - Lrho*(Lv-Lw));
+	rho2 = Lrho * (Lv - Lw) / (Mw - Lw);
+	rho3 = Rrho * (Rv - Rw) / (Mw - Rw);
+
+	if (Mw > 0) {
+		Mpress = Lrho*SQR(Lv) + Lpress - Lw*Lrho*Lv - rho2*SQR(Mw) + Lw*rho2*Mw;
+	} else if (Mw < 0) {
+		Mpress = Rrho*SQR(Rv) + Rpress - Rw*Rrho*Rv - rho3*SQR(Mw) + Rw*rho3*Mw;
+	} else {
+		Mpress = 0.5 * ((Lrho*SQR(Lv) + Lpress - Lw*Lrho*Lv - rho2*SQR(Mw) + Lw*rho2*Mw)
+				+ (Rrho*SQR(Rv) + Rpress - Rw*Rrho*Rv - rho3*SQR(Mw) + Rw*rho3*Mw));
+	}
 
-			if (Mw < 0) {
-				// intermediate energy
-				e3 = (Rv*(Re+Rpress) - Rw*Re - Mw*Mpress) / (Mw - Rw);
-
-				J(0,i,j) = rho3 * Mw;
-				if (dir == 0) {
-					J(1,i,j) = rho3 * SQR(Mw) + Mpress;
-					J(2,i,j) = rho3 * Rprim(2,i,j) * Mw;
-				} else {
-					J(1,i,j) = rho3 * Rprim(1,i,j) * Mw;
-					J(2,i,j) = rho3 * SQR(Mw) + Mpress;
-				}
-				J(3,i,j) = (e3 + Mpress) * Mw;
-				for (m = 4; m < NQUANT; m++) {
-					J(m,i,j) = rho3 * Rprim(m,i,j) * Mw;
-				}
-			} else {
-				// intermediate energy
-				e2 = (Lv*(Le+Lpress) - Lw*Le - Mw*Mpress) / (Mw - Lw);
-
-				J(0,i,j) = rho2 * Mw;
-				if (dir == 0) {
-					J(1,i,j) = rho2 * SQR(Mw) + Mpress;
-					J(2,i,j) = rho2 * Lprim(2,i,j) * Mw;
-				} else {
-					J(1,i,j) = rho2 * Lprim(1,i,j) * Mw;
-					J(2,i,j) = rho2 * SQR(Mw) + Mpress;
-				}
-				J(3,i,j) = (e2 + Mpress) * Mw;
-				for (m = 4; m < NQUANT; m++) {
-					J(m,i,j) = rho2 * Lprim(m,i,j) * Mw;
-				}
+	// contact wave in middle
+	if (Mw == 0) {
+		for (m = 0; m < NQUANT; m++) {
+			J[m*Jstride + k] = 0;
+			if (m == 1+dir) {
+				J[m*Jstride + k] += Mpress;
 			}
 		}
+		return;
+	}
+
+	if (Mw < 0) {
+		// intermediate energy
+		e3 = (Rv*(Re+Rpress) - Rw*Re - Mw*Mpress) / (Mw - Rw);
+
+		J[k] = rho3 * Mw;
+		if (dir == 0) {
+			J[Jstride + k] = rho3 * SQR(Mw) + Mpress;
+			J[2*Jstride + k] = rho3 * Rprim[2*stride + k] * Mw;
+		} else {
+			J[Jstride + k] = rho3 * Rprim[stride + k] * Mw;
+			J[2*Jstride + k] = rho3 * SQR(Mw) + Mpress;
+		}
+		J[3*Jstride + k] = (e3 + Mpress) * Mw;
+		for (m = 4; m < NQUANT; m++) {
+			J[m*Jstride + k] = rho3 * Rprim[m*stride + k] * Mw;
+		}
+	} else {
+		// intermediate energy
+		e2 = (Lv*(Le+Lpress) - Lw*Le - Mw*Mpress) / (Mw - Lw);
+
+		J[k] = rho2 * Mw;
+		if (dir == 0) {
+			J[Jstride + k] = rho2 * SQR(Mw) + Mpress;
+			J[2*Jstride + k] = rho2 * Lprim[2*stride + k] * Mw;
+		} else {
+			J[Jstride + k] = rho2 * Lprim[stride + k] * Mw;
+			J[2*Jstride + k] = rho2 * SQR(Mw) + Mpress;
+		}
+		J[3*Jstride + k] = (e2 + Mpress) * Mw;
+		for (m = 4; m < NQUANT; m++) {
+			J[m*Jstride + k] = rho2 * Lprim[m*stride + k] * Mw;
+		}
 	}
 }
 
+#if SIMD_HLLC
+/*
+ * faces [k, k + vnumber::size()) at once: every wave pattern is evaluated for
+ * all lanes and the fluxes are blended with masks in the same precedence as
+ * hllc_face
+ */
+template<int dir>
+static inline void hllc_faces_simd(const number *Lprim, const number *Lcons, const number *Lw_array,
+	const number *Rprim, const number *Rcons, const number *Rw_array, int stride,
+	number *J, int Jstride, int k)
+{
+	const int v = (1+dir)*stride;
+	vnumber Lw, Rw, Mw;
+	vnumber Lv, Rv;
+	vnumber Lpress, Rpress, Mpress;
+	vnumber Lrho, Rrho, rho2, rho3, rhos;
+	vnumber Le, Re, e2, e3;
+	vmask zero, supR, supL, contact, right;
+
+	Lw = vnumber{&Lw_array[k], stdx::element_aligned};
+	Rw = vnumber{&Rw_array[k], stdx::element_aligned};
+	Lrho = vnumber{&Lprim[k], stdx::element_aligned};
+	Rrho = vnumber{&Rprim[k], stdx::element_aligned};
+	Lv = vnumber{&Lprim[v + k], stdx::element_aligned};
+	Rv = vnumber{&Rprim[v + k], stdx::element_aligned};
+	Lpress = vnumber{&Lprim[3*stride + k], stdx::element_aligned};
+	Rpress = vnumber{&Rprim[3*stride + k], stdx::element_aligned};
+	Le = vnumber{&Lcons[3*stride + k], stdx::element_aligned};
+	Re = vnumber{&Rcons[3*stride + k], stdx::element_aligned};
+
+	zero = (Lw == 0) && (Rw == 0);
+	supR = Rw < 0;
+	supL = Lw > 0;
+
+	// middle wave and intermediate left/right density
+	Mw = ((Rrho*Rv*(Rv-Rw) + Rpress) - (Lrho*Lv*(Lv-Lw) + Lpress)) / (Rrho*(Rv-Rw) - Lrho*(Lv-Lw));
+	rho2 = Lrho * (Lv - Lw) / (Mw - Lw);
+	rho3 = Rrho * (Rv - Rw) / (Mw - Rw);
+
+	vnumber ML = Lrho*(Lv*Lv) + Lpress - Lw*Lrho*Lv - rho2*(Mw*Mw) + Lw*rho2*Mw;
+	vnumber MR = Rrho*(Rv*Rv) + Rpress - Rw*Rrho*Rv - rho3*(Mw*Mw) + Rw*rho3*Mw;
+	Mpress = 0.5 * (ML + MR);
+	where(Mw > 0, Mpress) = ML;
+	where(Mw < 0, Mpress) = MR;
+
+	contact = Mw == 0;
+	right = Mw < 0;
+
+	// intermediate energy
+	e2 = (Lv*(Le+Lpress) - Lw*Le - Mw*Mpress) / (Mw - Lw);
+	e3 = (Rv*(Re+Rpress) - Rw*Re - Mw*Mpress) / (Mw - Rw);
+
+	rhos = rho2;
+	where(right, rhos) = rho3;
+
+	for (int m = 0; m < NQUANT; m++) {
+		const int q = m*stride + k;
+		vnumber Lq{&Lcons[q], stdx::element_aligned};
+		vnumber Rq{&Rcons[q], stdx::element_aligned};
+		vnumber flux, contact_flux, supL_flux, supR_flux;
+
+		supL_flux = Lq * Lv;
+		supR_flux = Rq * Rv;
+		contact_flux = 0;
+
+		if (m == 0) {
+			flux = rhos * Mw;
+		} else if (m == 1+dir) {
+			flux = rhos * (Mw*Mw) + Mpress;
+			contact_flux = Mpress;
+			supL_flux += Lpress;
+			supR_flux += Rpress;
+		} else if (m == 3) {
+			vnumber es = e2;
+			where(right, es) = e3;
+			flux = (es + Mpress) * Mw;
+			supL_flux += Lpress * Lv;
+			supR_flux += Rpress * Rv;
+		} else {
+			// tangential velocity and scalars carried from upwind side
+			vnumber prims{&Lprim[q], stdx::element_aligned};
+			where(right, prims) = vnumber{&Rprim[q], stdx::element_aligned};
+			flux = rhos * prims * Mw;
+		}
+
+		where(contact, flux) = contact_flux;
+		where(supL, flux) = supL_flux;
+		where(supR, flux) = supR_flux;
+		where(zero, flux) = 0;
+
+		flux.copy_to(&J[m*Jstride + k], stdx::element_aligned);
+	}
+}
+#endif /* SIMD_HLLC */
+
+template<int dir>
+void HLLCRow(const number *Lprim, const number *Lcons, const number *Lw_array,
+	const number *Rprim, const number *Rcons, const number *Rw_array, int stride,
+	number *J, int Jstride, int kl, int ku)
+{
+	int k = kl;
+
+#if SIMD_HLLC
+	for (; k + (int)vnumber::size() <= ku; k += vnumber::size()) {
+		hllc_faces_simd<dir>(Lprim, Lcons, Lw_array, Rprim, Rcons, Rw_array, stride,
+			J, Jstride, k);
+	}
+#endif /* SIMD_HLLC */
+
+	//face loop
+	for (; k < ku; k++) {
+		hllc_face<dir>(Lprim, Lcons, Lw_array, Rprim, Rcons, Rw_array, stride,
+			J, Jstride, k);
+	}
+}
+
+template void HLLCRow<0>(const number *, const number *, const number *,
+	const number *, const number *, const number *, int, number *, int, int, int);
+template void HLLCRow<1>(const number *, const number *, const number *,
+	const number *, const number *, const number *, int, number *, int, int, int);
+
 void HLLE(const Array<number> &Lcons, const Array<number> &LJ_array, const Array<number> &Lw_array,
 	const Array<number> &Rcons, const Array<number> &RJ_array, const Array<number> &Rw_array,
-	Array<number> &J, int dir, int il, int iuf, int jl, int ju)
+	Array<number> &J, int dir, int il, int iu, int jl, int ju)
 {
 	(void)dir;
 
+	for (int i = il; i < iu; i++) {
+		HLLERow(&Lcons(0,i,0), &LJ_array(0,i,0), &Lw_array(i,0),
+			&Rcons(0,i,0), &RJ_array(0,i,0), &Rw_array(i,0), Lcons.n[1]*Lcons.n[2],
+			&J(0,i,0), J.n[1]*J.n[2], jl, ju);
+	}
+}
+
+void HLLERow(const number *Lcons, const number *LJ_array, const number *Lw_array,
+	const number *Rcons, const number *RJ_array, const number *Rw_array, int stride,
+	number *J, int Jstride, int kl, int ku)
+{
 	for (int m = 0; m < NQUANT; m++) {
-		for (int i = il; i < iuf; i++) {
-			//face loop
-			for (int j = jl; j < ju+1; j++) {
-				number Lq, Rq, LJ, RJ, Lw, Rw;
-
-				Lq = Lcons(m,i,j);
-				Rq = Rcons(m,i,j);
-				LJ = LJ_array(m,i,j);
-				RJ = RJ_array(m,i,j);
-				Lw = Lw_array(i,j);
-				Rw = Rw_array(i,j);
-
-				if (Lw == 0 && Rw == 0) {
-					J(m,i,j) = 0;
-				} else if (Rw <= 0) {
-					J(m,i,j) = RJ;
-				} else if (Lw >= 0) {
-					J(m,i,j) = LJ;
-				} else {
-					J(m,i,j) = (LJ*Rw - RJ*Lw + Rw*Lw*(Rq - Lq)) / (Rw - Lw);
-				}
-			}
+		//face loop, selects instead of branches so it vectorizes
+		for (int k = kl; k < ku; k++) {
+			number Lq, Rq, LJ, RJ, Lw, Rw, flux;
+
+			Lq = Lcons[m*stride + k];
+			Rq = Rcons[m*stride + k];
+			LJ = LJ_array[m*stride + k];
+			RJ = RJ_array[m*stride + k];
+			Lw = Lw_array[k];
+			Rw = Rw_array[k];
+
+			flux = (LJ*Rw - RJ*Lw + Rw*Lw*(Rq - Lq)) / (Rw - Lw);
+			flux = (Lw >= 0) ? LJ : flux;
+			flux = (Rw <= 0) ? RJ : flux;
+			flux = (Lw == 0 && Rw == 0) ? 0 : flux;
+
+			J[m*Jstride + k] = flux;
 		}
 	}
 }
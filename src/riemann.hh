@@ -14,13 +14,26 @@
 
 namespace riemann {
 
+// faces [il, iu) x [jl, ju)
 void HLLC(const Array<number> &Lprim, const Array<number> &Lcons, const Array<number> &Lw_array,
 	const Array<number> &Rprim, const Array<number> &Rcons, const Array<number> &Rw_array,
-	Array<number> &J, int dir, int il, int iuf, int jl, int ju);
+	Array<number> &J, int dir, int il, int iu, int jl, int ju);
 
+// one row of faces [kl, ku): quantity m of face k at Lprim[m*stride + k]
+template<int dir>
+void HLLCRow(const number *Lprim, const number *Lcons, const number *Lw_array,
+	const number *Rprim, const number *Rcons, const number *Rw_array, int stride,
+	number *J, int Jstride, int kl, int ku);
+
+// faces [il, iu) x [jl, ju)
 void HLLE(const Array<number> &Lcons, const Array<number> &LJ_array, const Array<number> &Lw_array,
 	const Array<number> &Rcons, const Array<number> &RJ_array, const Array<number> &Rw_array,
-	Array<number> &J, int dir, int il, int iuf, int jl, int ju);
+	Array<number> &J, int dir, int il, int iu, int jl, int ju);
+
+// one row of faces [kl, ku): quantity m of face k at Lcons[m*stride + k]
+void HLLERow(const number *Lcons, const number *LJ_array, const number *Lw_array,
+	const number *Rcons, const number *RJ_array, const number *Rw_array, int stride,
+	number *J, int Jstride, int kl, int ku);
 
 } // namespace riemann
 
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2023 Bryance Oyang
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <experimental/simd>
+
+#include "macro.hh"
+
+namespace stdx = std::experimental;
+
+// native vector width of number
+typedef stdx::native_simd<number> vnumber;
+typedef vnumber::mask_type vmask;
+
+// SIGN() of each lane
+static inline vnumber vsign(const vnumber &x)
+{
+	vnumber s = 0;
+	where(x > 0, s) = 1;
+	where(x < 0, s) = -1;
+	return s;
+}
+
+#endif /* SIMD_H */
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2023 Bryance Oyang
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "grid.hh"
+#include "riemann.hh"
+
+void Grid::AllocScratch()
+{
+	int n = std::max(nu, nv) + 1;
+
+	Lprim_row = Array<number>{NQUANT, n};
+	Rprim_row = Array<number>{NQUANT, n};
+	Lcons_row = Array<number>{NQUANT, n};
+	Rcons_row = Array<number>{NQUANT, n};
+	Lw_row = Array<number>{n};
+	Rw_row = Array<number>{n};
+
+	if (riemann_solver == SOLVER_HLLE) {
+		LJ_row = Array<number>{NQUANT, n};
+		RJ_row = Array<number>{NQUANT, n};
+	}
+
+	if (TRANSPOSE_TILE > 0) {
+		prim_tile = Array<number>{NQUANT, TRANSPOSE_TILE, n};
+		J_tile = Array<number>{NQUANT, TRANSPOSE_TILE, n};
+	} else {
+		Lprim_next = Array<number>{NQUANT, n};
+	}
+}
+
+/*
+ * Direction agnostic 1D kernel over one pencil of cells contiguous along k,
+ * quantity m at q[m*stride + k]. Does Reconstruct, PrimLim, PrimToCons,
+ * Wavespeed and riemann flux for faces [kl, ku) into J[m*Jstride + k] and
+ * returns the minimum crossing time of cells bounded by these faces if
+ * find_dt.
+ */
+template<int order, int solver, int dir>
+number Grid::SweepPencil(const number *q, int stride,
+	number *J, int Jstride, int kl, int ku, bool find_dt)
+{
+	const int row_stride = Lprim_row.n[1];
+	const int n = (dir == 0) ? nu : nv;
+	const number ds = (dir == 0) ? du : dv;
+	number tmin = DBL_MAX;
+
+	for (int m = 0; m < NQUANT; m++) {
+		ReconstructRow<order>(&q[m*stride], 1,
+			&Rprim_row(m,0), &Lprim_row(m,1), kl-1, ku);
+	}
+	PrimLimRow(&Lprim_row(0,0), row_stride, kl, ku);
+	PrimLimRow(&Rprim_row(0,0), row_stride, kl, ku);
+	if (solver == SOLVER_HLLC) {
+		PrimToConsRow(&Lprim_row(0,0), &Lcons_row(0,0), row_stride, kl, ku);
+		PrimToConsRow(&Rprim_row(0,0), &Rcons_row(0,0), row_stride, kl, ku);
+	} else {
+		PrimToConsFluxRow<dir>(&Lprim_row(0,0), &Lcons_row(0,0), &LJ_row(0,0), row_stride, kl, ku);
+		PrimToConsFluxRow<dir>(&Rprim_row(0,0), &Rcons_row(0,0), &RJ_row(0,0), row_stride, kl, ku);
+	}
+
+	WavespeedRow<dir>(&Lprim_row(0,0), &Rprim_row(0,0), row_stride,
+		q - 1, q, stride, &Lw_row(0), &Rw_row(0), kl, ku);
+
+	if (solver == SOLVER_HLLC) {
+		riemann::HLLCRow<dir>(&Lprim_row(0,0), &Lcons_row(0,0), &Lw_row(0),
+			&Rprim_row(0,0), &Rcons_row(0,0), &Rw_row(0), row_stride,
+			J, Jstride, kl, ku);
+	} else {
+		riemann::HLLERow(&Lcons_row(0,0), &LJ_row(0,0), &Lw_row(0),
+			&Rcons_row(0,0), &RJ_row(0,0), &Rw_row(0), row_stride,
+			J, Jstride, kl, ku);
+	}
+
+	// faces bounding nonghost cells
+	if (find_dt) {
+		for (int k = kl; k < ku; k++) {
+			if (k < n-NGHOST) {
+				tmin = fmin(tmin, ds/fabs(Rw_row(k)));
+			}
+			if (k > NGHOST) {
+				tmin = fmin(tmin, ds/fabs(Lw_row(k)));
+			}
+		}
+	}
+
+	return tmin;
+}
+
+/*
+ * Does Reconstruct, PrimLim, PrimToCons, Wavespeed and riemann flux for one
+ * pencil of faces at a time so the L/R states stay in cache. Rows of J are
+ * written for faces [kl, ku) along dir of this grid's rows for dir 1 or
+ * columns for dir 0, all of them are [il, iuf) or [jl, juf). Only reads prim,
+ * so both directions can run without a barrier.
+ *
+ * dir 1 pencils are rows of prim. For dir 0, TRANSPOSE_TILE columns of prim
+ * are transposed into prim_tile so the same unit stride kernel applies, and
+ * the fluxes are transposed back from J_tile.
+ */
+void Grid::Sweep(int dir, bool find_dt, int kl, int ku)
+{
+	typedef void (Grid::*SweepKernel)(bool, int, int);
+	// [reconstruct_order-1][riemann_solver][dir]
+	static const SweepKernel kernels[3][NSOLVER][2] = {
+		{
+			{&Grid::SweepDir<1,SOLVER_HLLC,0>, &Grid::SweepDir<1,SOLVER_HLLC,1>},
+			{&Grid::SweepDir<1,SOLVER_HLLE,0>, &Grid::SweepDir<1,SOLVER_HLLE,1>},
+		},
+		{
+			{&Grid::SweepDir<2,SOLVER_HLLC,0>, &Grid::SweepDir<2,SOLVER_HLLC,1>},
+			{&Grid::SweepDir<2,SOLVER_HLLE,0>, &Grid::SweepDir<2,SOLVER_HLLE,1>},
+		},
+		{
+			{&Grid::SweepDir<3,SOLVER_HLLC,0>, &Grid::SweepDir<3,SOLVER_HLLC,1>},
+			{&Grid::SweepDir<3,SOLVER_HLLE,0>, &Grid::SweepDir<3,SOLVER_HLLE,1>},
+		},
+	};
+
+	// through a local, gcc's -fsanitize=bounds miscompiles the direct call
+	const SweepKernel kernel = kernels[reconstruct_order-1][riemann_solver][dir];
+	(this->*kernel)(find_dt, kl, ku);
+}
+
+template<int order, int solver, int dir>
+void Grid::SweepDir(bool find_dt, int kl, int ku)
+{
+	Array<number> &J = (dir == 0) ? Ju : Jv;
+	const int cell_stride = prim.n[1]*prim.n[2];
+	const int Jstride = J.n[1]*J.n[2];
+	number tmin = DBL_MAX;
+
+	if (dir == 1) {
+		for (int i = il; i < iu; i++) {
+			tmin = fmin(tmin, SweepPencil<order,solver,dir>(&prim(0,i,0), cell_stride,
+				&J(0,i,0), Jstride, kl, ku, find_dt));
+		}
+	} else if (TRANSPOSE_TILE > 0) {
+		const int tile_stride = prim_tile.n[1]*prim_tile.n[2];
+
+		for (int j0 = jl; j0 < ju; j0 += TRANSPOSE_TILE) {
+			const int nj = std::min(TRANSPOSE_TILE, ju - j0);
+
+			// cells [kl-3, ku+2) feed faces [kl, ku)
+			for (int m = 0; m < NQUANT; m++) {
+				for (int i = kl-3; i < ku+2; i++) {
+					for (int jj = 0; jj < nj; jj++) {
+						prim_tile(m,jj,i) = prim(m,i,j0+jj);
+					}
+				}
+			}
+
+			for (int jj = 0; jj < nj; jj++) {
+				tmin = fmin(tmin, SweepPencil<order,solver,dir>(&prim_tile(0,jj,0), tile_stride,
+					&J_tile(0,jj,0), tile_stride, kl, ku, find_dt));
+			}
+
+			for (int m = 0; m < NQUANT; m++) {
+				for (int i = kl; i < ku; i++) {
+					for (int jj = 0; jj < nj; jj++) {
+						J(m,i,j0+jj) = J_tile(m,jj,i);
+					}
+				}
+			}
+		}
+	} else {
+		const int stride = Lprim_row.n[1];
+
+		// cell row i gives R state of face i and L state of face i+1
+		for (int i = kl-1; i < ku; i++) {
+			for (int m = 0; m < NQUANT; m++) {
+				ReconstructRow<order>(&prim(m,i,0), prim.n[2],
+					&Rprim_row(m,0), &Lprim_next(m,0), jl, ju);
+			}
+			PrimLimRow(&Rprim_row(0,0), stride, jl, ju);
+			PrimLimRow(&Lprim_next(0,0), stride, jl, ju);
+
+			if (i >= kl) {
+				if (solver == SOLVER_HLLC) {
+					PrimToConsRow(&Lprim_row(0,0), &Lcons_row(0,0), stride, jl, ju);
+					PrimToConsRow(&Rprim_row(0,0), &Rcons_row(0,0), stride, jl, ju);
+				} else {
+					PrimToConsFluxRow<dir>(&Lprim_row(0,0), &Lcons_row(0,0), &LJ_row(0,0), stride, jl, ju);
+					PrimToConsFluxRow<dir>(&Rprim_row(0,0), &Rcons_row(0,0), &RJ_row(0,0), stride, jl, ju);
+				}
+
+				WavespeedRow<dir>(&Lprim_row(0,0), &Rprim_row(0,0), stride,
+					&prim(0,i-1,0), &prim(0,i,0), cell_stride,
+					&Lw_row(0), &Rw_row(0), jl, ju);
+
+				if (solver == SOLVER_HLLC) {
+					riemann::HLLCRow<dir>(&Lprim_row(0,0), &Lcons_row(0,0), &Lw_row(0),
+						&Rprim_row(0,0), &Rcons_row(0,0), &Rw_row(0), stride,
+						&J(0,i,0), Jstride, jl, ju);
+				} else {
+					riemann::HLLERow(&Lcons_row(0,0), &LJ_row(0,0), &Lw_row(0),
+						&Rcons_row(0,0), &RJ_row(0,0), &Rw_row(0), stride,
+						&J(0,i,0), Jstride, jl, ju);
+				}
+
+				// faces bounding nonghost cells
+				if (find_dt) {
+					for (int j = jl; j < ju; j++) {
+						if (i < nu-NGHOST) {
+							tmin = fmin(tmin, du/fabs(Rw_row(j)));
+						}
+						if (i > NGHOST) {
+							tmin = fmin(tmin, du/fabs(Lw_row(j)));
+						}
+					}
+				}
+			}
+
+			swap(Lprim_row, Lprim_next);
+		}
+	}
+
+	if (find_dt) {
+		dt_tile(dt_slot, tid) = fmin(dt_tile(dt_slot, tid), tmin);
+	}
+}
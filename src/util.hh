@@ -9,12 +9,21 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <cmath>
 #include "macro.hh"
 
 namespace util {
 
-number fmin3(number a, number b, number c);
-number fmin4(number a, number b, number c, number d);
+// also for simd types through fmin overloads found by ADL
+template<typename T> static inline T fmin3(T a, T b, T c)
+{
+	return fmin(fmin(a,b),c);
+}
+
+template<typename T> static inline T fmin4(T a, T b, T c, T d)
+{
+	return fmin(fmin(fmin(a,b),c),d);
+}
 
 }
 